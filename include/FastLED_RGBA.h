@@ -343,3 +343,66 @@ inline __attribute__((always_inline)) bool operator== (const CRGBA& lhs, const C
 inline __attribute__((always_inline)) bool operator!= (const CRGBA& lhs, const CRGB& rhs) {
     return !(lhs == rhs);
 }
+
+
+// premultiplied alpha version of CRGBA: r, g, and b have already been scaled by a.
+// blending one over a CRGB is then a single multiply and add per channel, see nblend_premultiplied().
+// a color can be turned into this form once and blended many times, but the original color can not be
+// recovered exactly from it, so effects should keep drawing into CRGBA.
+struct CPRGBA {
+  union {
+    struct {
+      uint8_t r;
+      uint8_t g;
+      uint8_t b;
+      uint8_t a;
+    };
+    uint8_t raw[4];
+  };
+
+  CPRGBA(){}
+
+  CPRGBA(uint8_t rd, uint8_t grn, uint8_t blu, uint8_t alph) {
+    r = rd;
+    g = grn;
+    b = blu;
+    a = alph;
+  }
+
+  // scale is applied to the color only, so a layer's brightness can be folded in at the same time
+  inline CPRGBA(const CRGBA& c, uint8_t scale = 255) __attribute__((always_inline)) {
+    a = c.a;
+    r = c.r;
+    g = c.g;
+    b = c.b;
+    nscale8x3(r, g, b, scale);
+    nscale8x3(r, g, b, a);
+  }
+
+  // with premultiplied alpha fading the alpha has to fade the color by the same amount, so both of these are the same.
+  // fadeToTransparentBy() on a CRGBA keeps the color so the proxy color survives. here the proxy color has
+  // already been substituted, so there is nothing to keep.
+  inline CPRGBA& fadeToTransparentBlackBy (uint8_t fadefactor) {
+    nscale8x3(r, g, b, 255 - fadefactor);
+    a = scale8(a, 255 - fadefactor);
+    return *this;
+  }
+
+  inline CPRGBA& fadeToTransparentBy (uint8_t fadefactor) {
+    return fadeToTransparentBlackBy(fadefactor);
+  }
+
+  inline explicit operator CRGB() const {
+    return CRGB(r, g, b);
+  }
+};
+
+
+// existing = overlay + existing*(1 - overlay alpha)
+inline CRGB& nblend_premultiplied(CRGB& existing, const CPRGBA& overlay) {
+  uint8_t transparency = 255 - overlay.a;
+  existing.r = qadd8(scale8(existing.r, transparency), overlay.r);
+  existing.g = qadd8(scale8(existing.g, transparency), overlay.g);
+  existing.b = qadd8(scale8(existing.b, transparency), overlay.b);
+  return existing;
+}
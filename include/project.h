@@ -24,8 +24,31 @@
 
 #define NUM_LAYERS 6  // changes to NUM_LAYERS will be reflected in compositor.htm
 #define REFRESH_INTERVAL 100 // minimum amount of time between display refreshes. best to leave this at 100 ms
+#define MAX_LOOP_SLEEP 20 // ms. loop() sleeps until the next deadline, but no longer than this so it still polls for DNS and web requests
 
-// storage locations for animated matrices and playlists.
+// bytes of RAM (or PSRAM if the board has it) for decoded images. see image_cache.h.
+// a 16x16 image takes 1 KB and a 32x32 image 4 KB. 0 turns the cache off.
+#ifndef IMAGE_CACHE_BYTES
+#define IMAGE_CACHE_BYTES 16384
+#endif
+
+// frames of a sprite sheet animation that are held in RAM at once, see ReAnimator::set_sequence().
+// one is shown while the loader task reads the rest ahead, so 2 is the least that plays smoothly.
+#ifndef SEQUENCE_BUFFER_FRAMES
+#define SEQUENCE_BUFFER_FRAMES 3
+#endif
+
+// how long a playlist item's transition ({"tr":"crossfade"} etc., see playlist_file.h) takes when it does not give "td", in ms.
+#ifndef TRANSITION_DURATION
+#define TRANSITION_DURATION 1000
+#endif
+// minimum time between display refreshes while a transition runs. REFRESH_INTERVAL would make a crossfade visibly step.
+// 32x32 takes about 31 ms to send, so this is about as fast as the largest matrix can go.
+#ifndef TRANSITION_REFRESH_INTERVAL
+#define TRANSITION_REFRESH_INTERVAL 33
+#endif
+
+// storage locations for animated matrices, playlists, and schedules.
 // note the pathes are hardcoded in the HTML files, so changing these defines is not enough.
 // do not put a / at the end
 #define FILE_ROOT "/files"
@@ -33,6 +56,7 @@
 #define CM_ROOT FILE_ROOT "/cm"
 #define AN_ROOT FILE_ROOT "/an"
 #define PL_ROOT FILE_ROOT "/pl"
+#define SC_ROOT FILE_ROOT "/sc"
 
 #undef DEBUG_CONSOLE
 #define DEBUG_CONSOLE Serial
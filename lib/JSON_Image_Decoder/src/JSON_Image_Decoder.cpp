@@ -24,11 +24,11 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-//#include <Arduino.h>
+#include <Arduino.h>
 #include <stdint.h>
 #include <FastLED.h>
 #include "FastLED_RGBA.h"
-#include "ArduinoJson-v6.h"
+#include "JSON_Image_Decoder.h"
 
 //color mangling macros from WLED wled.h
 //modified slightly for alpha channel instead of white channel
@@ -69,52 +69,285 @@ bool colorFromHexString(byte* rgb, const char* in) {
 }
 
 
-// slightly modified version of deserializeSegment() from WLED json.cpp
-bool deserializeSegment(JsonObject root, CRGBA leds[], uint16_t leds_len)
-{
-    JsonArray iarr = root[F("i")]; //set individual LEDs
-    if (!iarr.isNull()) {
-      uint16_t start = 0, stop = 0;
-      byte set = 0; //0 nothing set, 1 start set, 2 range set
-
-      for (size_t i = 0; i < iarr.size(); i++) {
-        if(iarr[i].is<JsonInteger>()) {
-          if (!set) {
-            start = abs(iarr[i].as<int>());
-            set++;
-          } else {
-            stop = abs(iarr[i].as<int>());
-            set++;
-          }
-        } else { //color
-          uint8_t rgba[] = {0,0,0,0};
-          JsonArray icol = iarr[i];
-          if (!icol.isNull()) { //array, e.g. [255,0,0]
-            byte sz = icol.size();
-            if (sz > 0 && sz < 5) copyArray(icol, rgba);
-          } else { //hex string, e.g. "FF0000"
-            byte brgba[] = {0,0,0,0};
-            const char* hexCol = iarr[i];
-            if (colorFromHexString(brgba, hexCol)) {
-              for (size_t c = 0; c < 4; c++) rgba[c] = brgba[c];
-            }
-          }
-
-          if (set < 2 || stop <= start) stop = start + 1;
-          // can use FastLED gamma function?
-          //uint32_t c = gamma32(RGBA32(rgba[0], rgba[1], rgba[2], rgba[3]));
-          uint32_t c = RGBA32(rgba[0], rgba[1], rgba[2], rgba[3]);
-          while (start < stop && start < leds_len) leds[start++] = c;
-          if (start > leds_len) {
-            // image is bigger than matrix
-            // return to avoid processing the rest of iarr unnecessarily
-            // if return false image will not be shown
-            // if return true partial image will be shown
-            return true;
-          }
-          set = 0;
+// the rest of this file replaces WLED's deserializeSegment(), which needed the whole image in a JsonDocument first.
+// the image is read one character at a time and pixels are written as soon as they are parsed,
+// so the only memory used is a few small buffers on the stack.
+// each reader takes the first character of what it reads, which has already been consumed,
+// and returns the next character after it that is not whitespace, or -1 if the input is malformed or ended early.
+
+#define JSON_IMAGE_MAX_NESTING 10 // same as ArduinoJson's default nesting limit
+
+static bool is_json_space(int c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+static int next_nonspace(Stream& in) {
+  int c;
+  do {
+    c = in.read();
+  } while (is_json_space(c));
+  return c;
+}
+
+
+// reads the rest of a string after its opening quote. the first len-1 characters are kept in buf as a C string.
+// the full length is put in total so a string too long for buf can be told apart from one that fit.
+// escapes are kept as the escaped character, which is all keys and hex colors need.
+static int read_string(Stream& in, char* buf, size_t len, size_t* total) {
+  size_t n = 0;
+  for (;;) {
+    int c = in.read();
+    if (c < 0) {
+      return -1;
+    }
+    if (c == '"') {
+      break;
+    }
+    if (c == '\\') {
+      c = in.read();
+      if (c < 0) {
+        return -1;
+      }
+    }
+    if (buf && n+1 < len) {
+      buf[n] = c;
+    }
+    n++;
+  }
+  if (buf && len) {
+    buf[min(n, len-1)] = '\0';
+  }
+  if (total) {
+    *total = n;
+  }
+  return next_nonspace(in);
+}
+
+
+// reads a number, true, false, or null
+static int read_scalar(Stream& in, int c, char* buf, size_t len) {
+  size_t n = 0;
+  while (c >= 0 && (isalnum(c) || c == '-' || c == '+' || c == '.')) {
+    if (buf && n+1 < len) {
+      buf[n] = c;
+    }
+    n++;
+    c = in.read();
+  }
+  if (n == 0) {
+    return -1;
+  }
+  if (buf && len) {
+    buf[min(n, len-1)] = '\0';
+  }
+  if (is_json_space(c)) {
+    c = next_nonspace(in);
+  }
+  return (c == ',' || c == ']' || c == '}') ? c : -1;
+}
+
+
+static bool is_json_integer(const char* num) {
+  return strpbrk(num, ".eE") == nullptr && (isdigit(num[0]) || num[0] == '-');
+}
+
+
+static int skip_value(Stream& in, int c, uint8_t depth) {
+  if (depth > JSON_IMAGE_MAX_NESTING) {
+    return -1;
+  }
+  if (c == '"') {
+    return read_string(in, nullptr, 0, nullptr);
+  }
+  if (c == '[' || c == '{') {
+    int close = (c == '[') ? ']' : '}';
+    c = next_nonspace(in);
+    if (c == close) {
+      return next_nonspace(in);
+    }
+    for (;;) {
+      if (close == '}') {
+        if (c != '"') {
+          return -1;
+        }
+        c = read_string(in, nullptr, 0, nullptr);
+        if (c != ':') {
+          return -1;
         }
+        c = next_nonspace(in);
+      }
+      c = skip_value(in, c, depth+1);
+      if (c == ',') {
+        c = next_nonspace(in);
+      }
+      else if (c == close) {
+        return next_nonspace(in);
+      }
+      else {
+        return -1;
       }
     }
-  return true;
+  }
+  return read_scalar(in, c, nullptr, 0);
+}
+
+
+// reads a color written as an array, e.g. [255,0,0] or [255,0,0,128], after its opening bracket.
+// like ArduinoJson's copyArray() into uint8_t, anything that is not a number from 0 to 255 is 0,
+// and an array of more than four values leaves the color black.
+static int read_color_array(Stream& in, uint8_t* rgba, uint8_t depth) {
+  uint8_t values[4] = {0, 0, 0, 0};
+  size_t count = 0;
+  int c = next_nonspace(in);
+  if (c == ']') {
+    return next_nonspace(in);
+  }
+  for (;;) {
+    if (c == '-' || isdigit(c)) {
+      char num[16];
+      c = read_scalar(in, c, num, sizeof(num));
+      double v = strtod(num, nullptr);
+      if (count < 4 && v >= 0 && v <= 255) {
+        values[count] = (uint8_t)v;
+      }
+    }
+    else {
+      c = skip_value(in, c, depth+1);
+    }
+    count++;
+
+    if (c == ',') {
+      c = next_nonspace(in);
+    }
+    else if (c == ']') {
+      break;
+    }
+    else {
+      return -1;
+    }
+  }
+  if (count < 5) {
+    memcpy(rgba, values, sizeof(values));
+  }
+  return next_nonspace(in);
+}
+
+
+// reads the "i" array after its opening bracket. integers set the index of the next color, or a range of indices
+// when two are given in a row, e.g. [0, "ff0000", 10, 20, "00ff00"]. otherwise colors go to consecutive LEDs.
+static int read_pixels(Stream& in, CRGBA leds[], uint16_t leds_len) {
+  uint16_t start = 0, stop = 0;
+  byte set = 0; //0 nothing set, 1 start set, 2 range set
+
+  int c = next_nonspace(in);
+  if (c == ']') {
+    return next_nonspace(in);
+  }
+  for (;;) {
+    bool is_color = true;
+    uint8_t rgba[] = {0,0,0,0};
+    if (c == '"') { //hex string, e.g. "FF0000"
+      char hex_col[10];
+      size_t n;
+      c = read_string(in, hex_col, sizeof(hex_col), &n);
+      if (n < sizeof(hex_col)) {
+        colorFromHexString(rgba, hex_col);
+      }
+    }
+    else if (c == '[') { //array, e.g. [255,0,0]
+      c = read_color_array(in, rgba, 1);
+    }
+    else if (c == '{') {
+      c = skip_value(in, c, 1);
+    }
+    else {
+      char num[16];
+      c = read_scalar(in, c, num, sizeof(num));
+      if (c >= 0 && is_json_integer(num)) {
+        is_color = false;
+        uint16_t index = abs((int)strtol(num, nullptr, 10));
+        if (!set) {
+          start = index;
+        } else {
+          stop = index;
+        }
+        set++;
+      }
+    }
+
+    if (c < 0) {
+      return -1;
+    }
+
+    if (is_color) {
+      if (set < 2 || stop <= start) stop = start + 1;
+      uint32_t col = RGBA32(rgba[0], rgba[1], rgba[2], rgba[3]);
+      while (start < stop && start < leds_len) leds[start++] = col;
+      set = 0;
+    }
+
+    if (c == ',') {
+      c = next_nonspace(in);
+    }
+    else if (c == ']') {
+      return next_nonspace(in);
+    }
+    else {
+      return -1;
+    }
+  }
+}
+
+
+bool deserializeSegmentStream(Stream& input, CRGBA leds[], uint16_t leds_len, bool* proxy_color_set, CRGB* proxy_color)
+{
+  *proxy_color_set = false;
+
+  int c = next_nonspace(input);
+  if (c != '{') {
+    return false;
+  }
+  c = next_nonspace(input);
+  if (c == '}') {
+    return true;
+  }
+  for (;;) {
+    if (c != '"') {
+      return false;
+    }
+    char key[4];
+    size_t key_len;
+    c = read_string(input, key, sizeof(key), &key_len);
+    if (c != ':') {
+      return false;
+    }
+    c = next_nonspace(input);
+
+    if (key_len == 2 && strcmp(key, "pc") == 0 && c == '"') {
+      char pc[16];
+      size_t n;
+      c = read_string(input, pc, sizeof(pc), &n);
+      if (n > 0 && n < sizeof(pc)) {
+        *proxy_color = strtoul(pc, nullptr, 16);
+        *proxy_color_set = true;
+      }
+    }
+    else if (key_len == 1 && key[0] == 'i' && c == '[') {
+      c = read_pixels(input, leds, leds_len);
+    }
+    else {
+      c = skip_value(input, c, 1);
+    }
+
+    if (c == ',') {
+      c = next_nonspace(input);
+    }
+    else if (c == '}') {
+      return true;
+    }
+    else {
+      return false;
+    }
+  }
 }
@@ -1,3 +1,4 @@
 #pragma once
-bool deserializeSegment(JsonObject elem, CRGBA leds[], uint16_t leds_len);
-
+// reads a JSON image, {"pc":"rrggbb", "i":[...]}, from input into leds[] without building a JsonDocument.
+// returns false if the JSON is malformed or ends early. leds[] may be partly written by then.
+bool deserializeSegmentStream(Stream& input, CRGBA leds[], uint16_t leds_len, bool* proxy_color_set, CRGB* proxy_color);
@@ -0,0 +1,188 @@
+// host stand-in for the parts of the Arduino core used by the render path.
+// only what ReAnimator.cpp and the compositor need is provided. this is not a general Arduino emulation.
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+
+#include "freertos/FreeRTOS.h"
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+#define F(string_literal) (string_literal)
+#define PROGMEM
+#define DEC 10
+#define HEX 16
+
+
+// the render path reads time exclusively through millis(), so swapping in a virtual clock
+// lets the host renderer and benchmarks step time deterministically instead of waiting on it.
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+inline void yield(void) {}
+
+void host_clock_use_virtual(bool enable);
+bool host_clock_is_virtual(void);
+void host_clock_set(uint32_t ms);
+void host_clock_advance(uint32_t ms);
+
+// wall clock seen by getLocalTime(). defaults to the host's time, but can be pinned so time of day effects are reproducible.
+void host_clock_set_epoch(time_t epoch);
+time_t host_time(void);
+bool getLocalTime(struct tm* info, uint32_t ms = 5000);
+void configTzTime(const char* tz, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+
+class String : public std::string {
+  public:
+    String() {}
+    String(const char* s) : std::string(s ? s : "") {}
+    String(const std::string& s) : std::string(s) {}
+    explicit String(char c) : std::string(1, c) {}
+    explicit String(int v) : std::string(std::to_string(v)) {}
+    explicit String(unsigned int v) : std::string(std::to_string(v)) {}
+    explicit String(long v) : std::string(std::to_string(v)) {}
+    explicit String(unsigned long v) : std::string(std::to_string(v)) {}
+
+    bool isEmpty() const { return empty(); }
+
+    int indexOf(char c, unsigned int from = 0) const {
+        size_type p = find(c, from);
+        return (p == npos) ? -1 : (int)p;
+    }
+
+    int indexOf(const String& s, unsigned int from = 0) const {
+        size_type p = find(s, from);
+        return (p == npos) ? -1 : (int)p;
+    }
+
+    int lastIndexOf(char c) const {
+        size_type p = rfind(c);
+        return (p == npos) ? -1 : (int)p;
+    }
+
+    int lastIndexOf(const String& s) const {
+        size_type p = rfind(s);
+        return (p == npos) ? -1 : (int)p;
+    }
+
+    String substring(unsigned int from) const {
+        return (from < length()) ? String(substr(from)) : String();
+    }
+
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        return (from < length()) ? String(substr(from, to-from)) : String();
+    }
+
+    bool startsWith(const String& s) const { return compare(0, s.length(), s) == 0; }
+    bool endsWith(const String& s) const { return length() >= s.length() && compare(length()-s.length(), s.length(), s) == 0; }
+
+    void remove(unsigned int index) { if (index < length()) erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < length()) erase(index, count); }
+
+    void trim() {
+        size_type b = find_first_not_of(" \t\r\n");
+        size_type e = find_last_not_of(" \t\r\n");
+        *this = (b == npos) ? String() : String(substr(b, e-b+1));
+    }
+
+    void toLowerCase() { for (auto& c : *this) c = tolower(c); }
+
+    void replace(const String& from, const String& to) {
+        if (from.empty()) return;
+        size_type p = 0;
+        while ((p = find(from, p)) != npos) {
+            std::string::replace(p, from.length(), to);
+            p += to.length();
+        }
+    }
+
+    long toInt() const { return strtol(c_str(), nullptr, 10); }
+};
+
+
+class Stream {
+  public:
+    virtual ~Stream() {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual size_t readBytes(char* buffer, size_t length) {
+        size_t n = 0;
+        while (n < length) {
+            int c = read();
+            if (c < 0) break;
+            buffer[n++] = (char)c;
+        }
+        return n;
+    }
+
+    // as Arduino's, minus the timeout since a file never has to wait for more data
+    bool find(const char* target) {
+        return findUntil(target, "");
+    }
+
+    bool findUntil(const char* target, const char* terminator) {
+        size_t t = 0;
+        size_t u = 0;
+        size_t target_len = strlen(target);
+        size_t terminator_len = strlen(terminator);
+        int c;
+        while ((c = read()) >= 0) {
+            t = (c == target[t]) ? t+1 : (c == target[0]);
+            if (t == target_len) {
+                return true;
+            }
+            if (terminator_len > 0) {
+                u = (c == terminator[u]) ? u+1 : (c == terminator[0]);
+                if (u == terminator_len) {
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+};
+
+
+// debug output goes to stderr so stdout can carry raw frames
+class HostSerial {
+    template <typename T>
+    void put(const T& v) {
+        if constexpr (std::is_same<T, bool>::value) {
+            fprintf(stderr, "%d", v ? 1 : 0);
+        }
+        else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+            fprintf(stderr, "%lld", (long long)v);
+        }
+        else if constexpr (std::is_integral<T>::value) {
+            fprintf(stderr, "%llu", (unsigned long long)v);
+        }
+        else if constexpr (std::is_floating_point<T>::value) {
+            fprintf(stderr, "%.2f", (double)v);
+        }
+        else if constexpr (std::is_convertible<T, std::string>::value) {
+            fputs(std::string(v).c_str(), stderr);
+        }
+    }
+
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    template <typename T> void print(const T& v) { put(v); }
+    template <typename T> void println(const T& v) { put(v); fputc('\n', stderr); }
+    void println(void) { fputc('\n', stderr); }
+    template <typename... Args> void printf(const char* fmt, Args... args) { fprintf(stderr, fmt, args...); }
+};
+
+extern HostSerial Serial;
@@ -0,0 +1,328 @@
+// host stand-in for the subset of FastLED 3.6.0 used by the render path.
+// the 8-bit math follows FastLED's portable C implementations (FASTLED_SCALE8_FIXED and FASTLED_BLEND_FIXED)
+// so composited frames match what the ESP32 produces. rgb2hsv_approximate() is a simpler approximation.
+#pragma once
+
+#include <Arduino.h>
+
+typedef uint8_t fract8;
+typedef uint16_t fract16;
+typedef uint16_t accum88;
+
+typedef enum {
+    HUE_RED = 0,
+    HUE_ORANGE = 32,
+    HUE_YELLOW = 64,
+    HUE_GREEN = 96,
+    HUE_AQUA = 128,
+    HUE_BLUE = 160,
+    HUE_PURPLE = 192,
+    HUE_PINK = 224
+} HSVHue;
+
+
+// ++++++++++++++++++++++++++++++
+// +++++++++++ LIB8TION +++++++++
+// ++++++++++++++++++++++++++++++
+inline uint8_t scale8(uint8_t i, fract8 scale) {
+    return (((uint16_t)i) * (1 + (uint16_t)(scale))) >> 8;
+}
+
+inline uint8_t scale8_video(uint8_t i, fract8 scale) {
+    return (((int)i * (int)scale) >> 8) + ((i && scale) ? 1 : 0);
+}
+
+inline void nscale8x3(uint8_t& r, uint8_t& g, uint8_t& b, fract8 scale) {
+    uint16_t scale_fixed = scale + 1;
+    r = (((uint16_t)r) * scale_fixed) >> 8;
+    g = (((uint16_t)g) * scale_fixed) >> 8;
+    b = (((uint16_t)b) * scale_fixed) >> 8;
+}
+
+inline uint16_t scale16(uint16_t i, fract16 scale) {
+    return ((uint32_t)(i) * (1 + (uint32_t)(scale))) / 65536;
+}
+
+inline uint8_t qadd8(uint8_t i, uint8_t j) {
+    unsigned int t = i + j;
+    return (t > 255) ? 255 : t;
+}
+
+inline uint8_t qsub8(uint8_t i, uint8_t j) {
+    int t = i - j;
+    return (t < 0) ? 0 : t;
+}
+
+inline uint8_t blend8(uint8_t a, uint8_t b, uint8_t amountOfB) {
+    uint16_t partial;
+    partial = (a << 8) | b;
+    partial += (b * amountOfB);
+    partial -= (a * amountOfB);
+    return partial >> 8;
+}
+
+inline uint8_t triwave8(uint8_t in) {
+    if (in & 0x80) {
+        in = 255 - in;
+    }
+    return in << 1;
+}
+
+inline uint8_t sin8(uint8_t theta) {
+    static const uint8_t b_m16_interleave[] = { 0, 49, 49, 41, 90, 27, 117, 10 };
+    uint8_t offset = theta;
+    if (theta & 0x40) {
+        offset = (uint8_t)255 - offset;
+    }
+    offset &= 0x3F;
+
+    uint8_t secoffset = offset & 0x0F;
+    if (theta & 0x40) {
+        ++secoffset;
+    }
+
+    uint8_t section = offset >> 4;
+    const uint8_t* p = b_m16_interleave + (section * 2);
+    uint8_t b = *p++;
+    uint8_t m16 = *p;
+    uint8_t mx = (m16 * secoffset) >> 4;
+
+    int8_t y = mx + b;
+    if (theta & 0x80) {
+        y = -y;
+    }
+    y += 128;
+    return y;
+}
+
+inline int16_t sin16(uint16_t theta) {
+    static const uint16_t base[] = { 0, 6393, 12539, 18204, 23170, 27245, 30273, 32137 };
+    static const uint8_t slope[] = { 49, 48, 44, 38, 31, 23, 14, 4 };
+
+    uint16_t offset = (theta & 0x3FFF) >> 3;
+    if (theta & 0x4000) {
+        offset = 2047 - offset;
+    }
+
+    uint8_t section = offset / 256;
+    uint16_t b = base[section];
+    uint8_t m = slope[section];
+    uint8_t secoffset8 = (uint8_t)(offset) / 2;
+    uint16_t mx = m * secoffset8;
+    int16_t y = mx + b;
+    if (theta & 0x8000) {
+        y = -y;
+    }
+    return y;
+}
+
+inline uint16_t beat88(accum88 beats_per_minute_88, uint32_t timebase = 0) {
+    return ((millis() - timebase) * beats_per_minute_88 * 280) >> 16;
+}
+
+inline uint16_t beat16(accum88 beats_per_minute, uint32_t timebase = 0) {
+    if (beats_per_minute < 256) {
+        beats_per_minute <<= 8;
+    }
+    return beat88(beats_per_minute, timebase);
+}
+
+inline uint16_t beatsin16(accum88 beats_per_minute, uint16_t lowest = 0, uint16_t highest = 65535, uint32_t timebase = 0, uint16_t phase_offset = 0) {
+    uint16_t beat = beat16(beats_per_minute, timebase);
+    uint16_t beatsin = (sin16(beat + phase_offset) + 32768);
+    uint16_t rangewidth = highest - lowest;
+    uint16_t scaledbeat = scale16(beatsin, rangewidth);
+    return lowest + scaledbeat;
+}
+
+extern uint16_t rand16seed;
+
+inline uint8_t random8() {
+    rand16seed = (rand16seed * 2053) + 13849;
+    return (uint8_t)(((uint8_t)(rand16seed & 0xFF)) + ((uint8_t)(rand16seed >> 8)));
+}
+
+inline uint8_t random8(uint8_t lim) {
+    return (random8() * lim) >> 8;
+}
+
+inline uint8_t random8(uint8_t min, uint8_t lim) {
+    return random8(lim - min) + min;
+}
+
+inline uint16_t random16() {
+    rand16seed = (rand16seed * 2053) + 13849;
+    return rand16seed;
+}
+
+inline uint16_t random16(uint16_t lim) {
+    uint32_t p = (uint32_t)lim * (uint32_t)random16();
+    return p >> 16;
+}
+
+inline uint16_t random16(uint16_t min, uint16_t lim) {
+    return random16(lim - min) + min;
+}
+
+inline void random16_set_seed(uint16_t seed) {
+    rand16seed = seed;
+}
+
+
+// ++++++++++++++++++++++++++++++
+// ++++++++ PIXEL TYPES +++++++++
+// ++++++++++++++++++++++++++++++
+struct CHSV {
+    union {
+        struct {
+            union { uint8_t hue; uint8_t h; };
+            union { uint8_t saturation; uint8_t sat; uint8_t s; };
+            union { uint8_t value; uint8_t val; uint8_t v; };
+        };
+        uint8_t raw[3];
+    };
+
+    CHSV() {}
+    CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {}
+};
+
+struct CRGB;
+void hsv2rgb_rainbow(const CHSV& hsv, CRGB& rgb);
+CHSV rgb2hsv_approximate(const CRGB& rgb);
+
+struct CRGB {
+    union {
+        struct {
+            union { uint8_t r; uint8_t red; };
+            union { uint8_t g; uint8_t green; };
+            union { uint8_t b; uint8_t blue; };
+        };
+        uint8_t raw[3];
+    };
+
+    typedef enum {
+        Black=0x000000,
+        Blue=0x0000FF,
+        Green=0x008000,
+        Red=0xFF0000,
+        White=0xFFFFFF,
+        Yellow=0xFFFF00
+    } HTMLColorCode;
+
+    CRGB() {}
+    CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+    CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b((colorcode >> 0) & 0xFF) {}
+    CRGB(HTMLColorCode colorcode) : CRGB((uint32_t)colorcode) {}
+    CRGB(const CHSV& rhs) { hsv2rgb_rainbow(rhs, *this); }
+
+    inline CRGB& operator= (const uint32_t colorcode) {
+        r = (colorcode >> 16) & 0xFF;
+        g = (colorcode >>  8) & 0xFF;
+        b = (colorcode >>  0) & 0xFF;
+        return *this;
+    }
+
+    inline CRGB& operator= (const CHSV& rhs) {
+        hsv2rgb_rainbow(rhs, *this);
+        return *this;
+    }
+
+    inline CRGB& operator-= (const CRGB& rhs) {
+        r = qsub8(r, rhs.r);
+        g = qsub8(g, rhs.g);
+        b = qsub8(b, rhs.b);
+        return *this;
+    }
+
+    inline CRGB& operator+= (const CRGB& rhs) {
+        r = qadd8(r, rhs.r);
+        g = qadd8(g, rhs.g);
+        b = qadd8(b, rhs.b);
+        return *this;
+    }
+
+    inline CRGB& nscale8(uint8_t scaledown) {
+        nscale8x3(r, g, b, scaledown);
+        return *this;
+    }
+
+    inline uint8_t& operator[] (uint8_t x) { return raw[x]; }
+};
+
+inline bool operator== (const CRGB& lhs, const CRGB& rhs) {
+    return (lhs.r == rhs.r) && (lhs.g == rhs.g) && (lhs.b == rhs.b);
+}
+
+inline bool operator!= (const CRGB& lhs, const CRGB& rhs) {
+    return !(lhs == rhs);
+}
+
+inline CRGB operator- (const CRGB& p1, const CRGB& p2) {
+    return CRGB(qsub8(p1.r, p2.r), qsub8(p1.g, p2.g), qsub8(p1.b, p2.b));
+}
+
+inline CRGB operator+ (const CRGB& p1, const CRGB& p2) {
+    return CRGB(qadd8(p1.r, p2.r), qadd8(p1.g, p2.g), qadd8(p1.b, p2.b));
+}
+
+inline CRGB& nblend(CRGB& existing, const CRGB& overlay, fract8 amountOfOverlay) {
+    if (amountOfOverlay == 0) {
+        return existing;
+    }
+
+    if (amountOfOverlay == 255) {
+        existing = overlay;
+        return existing;
+    }
+
+    existing.red   = blend8(existing.red,   overlay.red,   amountOfOverlay);
+    existing.green = blend8(existing.green, overlay.green, amountOfOverlay);
+    existing.blue  = blend8(existing.blue,  overlay.blue,  amountOfOverlay);
+    return existing;
+}
+
+
+// ++++++++++++++++++++++++++++++
+// ++++++++++ CONTROLLER ++++++++
+// ++++++++++++++++++++++++++++++
+// there is no strip to drive, so show() only counts transmissions and hands the frame to an optional hook.
+// the host renderer uses the hook to capture what would have been sent to the LEDs.
+class CFastLED {
+    CRGB* m_leds = nullptr;
+    int m_num_leds = 0;
+    uint8_t m_brightness = 255;
+    uint32_t m_show_count = 0;
+    void(*m_show_hook)(const CRGB*, int, uint8_t) = nullptr;
+
+  public:
+    void addLeds(CRGB* data, int num_leds) { m_leds = data; m_num_leds = num_leds; }
+    void setLeds(CRGB* data) { m_leds = data; }
+    CRGB* leds() { return m_leds; }
+    int size() { return m_num_leds; }
+
+    void setBrightness(uint8_t scale) { m_brightness = scale; }
+    uint8_t getBrightness() { return m_brightness; }
+    void setMaxPowerInVoltsAndMilliamps(uint8_t volts, uint32_t milliamps) {}
+    void setDither(uint8_t dither_mode) {}
+
+    void clear(bool write_data = false) {
+        if (m_leds) {
+            memset((void*)m_leds, 0, m_num_leds*sizeof(CRGB));
+        }
+        if (write_data) {
+            show();
+        }
+    }
+
+    void show() {
+        m_show_count++;
+        if (m_show_hook) {
+            m_show_hook(m_leds, m_num_leds, m_brightness);
+        }
+    }
+
+    void set_show_hook(void(*hook)(const CRGB*, int, uint8_t)) { m_show_hook = hook; }
+    uint32_t get_show_count() { return m_show_count; }
+};
+
+extern CFastLED FastLED;
@@ -0,0 +1,56 @@
+// host stand-in for LittleFS. paths are resolved under a host directory, which defaults to data_free/
+// so the example art that ships with the project can be rendered without building a filesystem image.
+#pragma once
+
+#include <Arduino.h>
+#include <cstdio>
+
+class File : public Stream {
+    FILE* m_fp = nullptr;
+    void* m_dir = nullptr;
+    String m_path; // path as seen by the firmware, e.g. /files/im/mona.json
+    String m_host_path;
+
+  public:
+    File() {}
+    File(const String& path, const String& host_path, const char* mode);
+    File(const File& other) = delete;
+    File(File&& other);
+    File& operator=(File&& other);
+    ~File();
+
+    explicit operator bool() const { return m_fp != nullptr || m_dir != nullptr; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    bool seek(uint32_t pos);
+    size_t position();
+    size_t size();
+    void close();
+
+    const char* name() const;
+    const char* path() const { return m_path.c_str(); }
+    bool isDirectory() const { return m_dir != nullptr; }
+    File openNextFile();
+};
+
+
+class HostLittleFS {
+    String m_root = "data_free";
+
+  public:
+    bool begin(const char* host_root = nullptr);
+    String host_path(const String& path) const;
+
+    File open(const String& path, const char* mode = "r");
+    bool exists(const String& path);
+    bool remove(const String& path);
+    bool rename(const String& from, const String& to);
+    bool mkdir(const String& path);
+};
+
+extern HostLittleFS LittleFS;
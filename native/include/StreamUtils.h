@@ -0,0 +1,46 @@
+// host stand-in for StreamUtils' ReadBufferingStream. reads from the upstream Stream in chunks of capacity bytes.
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+class ReadBufferingStream : public Stream {
+    Stream& m_upstream;
+    std::vector<char> m_buffer;
+    size_t m_begin = 0;
+    size_t m_end = 0;
+
+    bool fill() {
+        if (m_begin == m_end) {
+            m_begin = 0;
+            m_end = m_upstream.readBytes(m_buffer.data(), m_buffer.size());
+        }
+        return m_begin < m_end;
+    }
+
+  public:
+    ReadBufferingStream(Stream& upstream, size_t capacity) : m_upstream(upstream), m_buffer(capacity) {}
+
+    int available() override {
+        return (m_end - m_begin) + m_upstream.available();
+    }
+
+    int read() override {
+        return fill() ? (uint8_t)m_buffer[m_begin++] : -1;
+    }
+
+    int peek() override {
+        return fill() ? (uint8_t)m_buffer[m_begin] : -1;
+    }
+
+    size_t readBytes(char* buffer, size_t length) override {
+        size_t n = 0;
+        while (n < length && fill()) {
+            size_t chunk = std::min(length - n, m_end - m_begin);
+            memcpy(buffer + n, m_buffer.data() + m_begin, chunk);
+            m_begin += chunk;
+            n += chunk;
+        }
+        return n;
+    }
+};
@@ -0,0 +1,51 @@
+// host stand-in for the handful of FreeRTOS queue and task calls used by the render path.
+// tasks are std::threads and queues are mutex protected deques. one tick is one millisecond
+// of real time, which matches the ESP32 Arduino core's default configTICK_RATE_HZ of 1000.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define errQUEUE_FULL 0
+#define portMAX_DELAY (TickType_t)0xffffffffUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+struct HostQueue;
+typedef HostQueue* QueueHandle_t;
+
+struct HostTask;
+typedef HostTask* TaskHandle_t;
+
+struct HostMutex;
+typedef HostMutex* SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+// only mutexes are used, so a semaphore is always a std::timed_mutex
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack_depth, void* parameter, UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id);
+void vTaskDelay(TickType_t ticks);
+// these follow millis(), so a task that sleeps until a deadline moves the virtual clock instead of waiting on it
+TickType_t xTaskGetTickCount(void);
+void vTaskDelayUntil(TickType_t* previous_wake_time, TickType_t time_increment);
+void vTaskDelete(TaskHandle_t task);
+
+// direct to task notifications, used as a counting semaphore. notifications wait in real time like vTaskDelay().
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait);
@@ -0,0 +1,93 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <Arduino.h>
+
+HostSerial Serial;
+
+static const auto boot_time = std::chrono::steady_clock::now();
+static std::atomic<bool> virtual_clock(false);
+static std::atomic<uint32_t> virtual_ms(0);
+static std::atomic<time_t> pinned_epoch(0);
+
+
+static uint64_t real_us(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot_time).count();
+}
+
+
+uint32_t millis(void) {
+  if (virtual_clock) {
+    return virtual_ms;
+  }
+  return real_us()/1000;
+}
+
+
+uint32_t micros(void) {
+  if (virtual_clock) {
+    return virtual_ms*1000;
+  }
+  return real_us();
+}
+
+
+void delay(uint32_t ms) {
+  if (virtual_clock) {
+    virtual_ms += ms;
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+
+void host_clock_use_virtual(bool enable) {
+  if (enable && !virtual_clock) {
+    // continue from the current time so elapsed time checks that straddle the switch stay sane
+    virtual_ms = real_us()/1000;
+  }
+  virtual_clock = enable;
+}
+
+
+bool host_clock_is_virtual(void) {
+  return virtual_clock;
+}
+
+
+void host_clock_set(uint32_t ms) {
+  virtual_ms = ms;
+}
+
+
+void host_clock_advance(uint32_t ms) {
+  virtual_ms += ms;
+}
+
+
+void host_clock_set_epoch(time_t epoch) {
+  pinned_epoch = epoch;
+}
+
+
+time_t host_time(void) {
+  if (pinned_epoch) {
+    // a pinned wall clock advances with millis() so it follows the virtual clock too
+    return pinned_epoch + millis()/1000;
+  }
+  return time(nullptr);
+}
+
+
+bool getLocalTime(struct tm* info, uint32_t ms) {
+  time_t now = host_time();
+  localtime_r(&now, info);
+  return info->tm_year > (2016 - 1900);
+}
+
+
+void configTzTime(const char* tz, const char* server1, const char* server2, const char* server3) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
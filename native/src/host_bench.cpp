@@ -0,0 +1,250 @@
+#include <chrono>
+#include <vector>
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "FastLED_RGBA.h"
+#include "ReAnimator.h"
+#include "host_bench.h"
+#include "host_heap.h"
+
+struct BenchResult {
+  uint64_t run_ns;        // total time spent in run_pattern() or apply_accent()
+  uint64_t blend_ns;      // total time spent blending the layer onto a black background
+  uint64_t worst_ns;      // slowest single frame, run plus blend
+  size_t peak_heap;       // most heap held at once by the layer, including the ReAnimator object itself
+  uint64_t bytes_touched; // total bytes of the layer's leds[] that changed
+};
+
+static const struct {
+  Pattern pattern;
+  const char* name;
+} bench_patterns[] = {
+  {DYNAMIC_RAINBOW, "dynamic_rainbow"},
+  {SOLID, "solid"},
+  {ORBIT, "orbit"},
+  {RUNNING_LIGHTS, "running_lights"},
+  {RIFFLE, "riffle"},
+  {SPARKLE, "sparkle"},
+  {WEAVE, "weave"},
+  {PENDULUM, "pendulum"},
+  {BINARY_SYSTEM, "binary_system"},
+  {SHOOTING_STAR, "shooting_star"},
+  {PUCK_MAN, "puck_man"},
+  {CYLON, "cylon"},
+  {FUNKY, "funky"},
+  {RAIN, "rain"},
+  {WATERFALL, "waterfall"},
+  {XRAY_SPARKLE, "xray_sparkle"},
+  {XRAY_ORBIT, "xray_orbit"},
+  {XRAY_SCAN, "xray_scan"},
+  {NO_PATTERN, "no_pattern"},
+  {THEATER_CHASE, "theater_chase"},
+  {CHECKERBOARD, "checkerboard"}
+};
+
+static const struct {
+  Accent accent;
+  const char* name;
+} bench_accents[] = {
+  {NO_ACCENT, "no_accent"},
+  {BREATHING, "breathing"},
+  {FLICKER, "flicker"},
+  {FROZEN_DECAY, "frozen_decay"}
+};
+
+// how a layer moves is set by its heading. 0 is stationary, 1 through 8 go around the compass starting at north.
+static const uint8_t bench_headings[] = {0, 1, 2, 3};
+
+enum BenchKind {BENCH_PATTERN, BENCH_ACCENT, BENCH_HEADING};
+
+// layers that make render_span() take each of its paths. they are blended over and over without changing,
+// so the time is only the blend and is steady enough to compare one build against another.
+enum BlendCase {BLEND_OPAQUE, BLEND_TRANSLUCENT, BLEND_PROXY, BLEND_XRAY};
+
+static const struct {
+  BlendCase blend_case;
+  const char* name;
+} bench_blends[] = {
+  {BLEND_OPAQUE, "opaque"},
+  {BLEND_TRANSLUCENT, "translucent"},
+  {BLEND_PROXY, "proxy_image"},
+  {BLEND_XRAY, "xray"}
+};
+
+static const struct {
+  uint8_t rows;
+  uint8_t cols;
+} bench_sizes[] = {{8, 8}, {16, 16}, {32, 32}};
+
+
+static uint64_t now_ns(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// friend of ReAnimator so it can reach run_pattern() and apply_accent() without going through reanimate()
+class LayerBench {
+  public:
+    static BenchResult run(uint8_t rows, uint8_t cols, uint8_t orientation, BenchKind kind, uint8_t effect,
+                           uint32_t num_frames, uint32_t step, std::vector<CRGB>& out, std::vector<CRGBA>& before);
+    static uint64_t blend(uint8_t rows, uint8_t cols, uint8_t orientation, BlendCase blend_case, uint32_t num_frames, std::vector<CRGB>& out);
+};
+
+
+BenchResult LayerBench::run(uint8_t rows, uint8_t cols, uint8_t orientation, BenchKind kind, uint8_t effect,
+                            uint32_t num_frames, uint32_t step, std::vector<CRGB>& out, std::vector<CRGBA>& before) {
+  BenchResult r = {};
+  uint16_t num_leds = rows*cols;
+
+  // every effect starts from the same time and random sequence so runs are comparable
+  host_clock_set(0);
+  random16_set_seed(1337);
+
+  host_heap_reset_peak();
+  size_t heap_base = host_heap_stats().in_use;
+
+  ReAnimator* layer = new ReAnimator(rows, cols, orientation);
+  if (kind == BENCH_PATTERN) {
+    layer->setup(Pattern_t, effect);
+    layer->set_pattern(static_cast<Pattern>(effect));
+  }
+  else {
+    // accents and movement work on whatever is already in leds[], so give them an opaque layer to chew on
+    layer->setup(Pattern_t, NO_PATTERN);
+    layer->set_pattern(NO_PATTERN);
+    layer->fill_solid(layer->leds, num_leds, CRGBA(CRGB::White));
+    if (kind == BENCH_ACCENT) {
+      layer->set_accent(static_cast<Accent>(effect), true);
+    }
+    else {
+      layer->set_heading(effect);
+    }
+  }
+
+  for (uint32_t f = 0; f < num_frames; f++) {
+    memcpy((void*)before.data(), (void*)layer->leds, num_leds*sizeof(CRGBA));
+    memset((void*)out.data(), 0, num_leds*sizeof(CRGB));
+
+    uint64_t t0 = now_ns();
+    if (kind == BENCH_PATTERN) {
+      layer->run_pattern(static_cast<Pattern>(effect));
+      // same bookkeeping as reanimate(). patterns restart themselves while pattern != last_pattern.
+      layer->last_pattern = layer->pattern;
+    }
+    else if (kind == BENCH_ACCENT) {
+      layer->apply_accent(static_cast<Accent>(effect));
+    }
+    // same bookkeeping as reanimate() does when leds[] may have changed
+    layer->mark_leds_changed();
+    uint64_t t1 = now_ns();
+    layer->render_span(out.data(), 0, num_leds);
+    uint64_t t2 = now_ns();
+
+    r.run_ns += t1 - t0;
+    r.blend_ns += t2 - t1;
+    r.worst_ns = max(r.worst_ns, t2 - t0);
+
+    const uint8_t* a = (const uint8_t*)before.data();
+    const uint8_t* b = (const uint8_t*)layer->leds;
+    for (uint32_t i = 0; i < num_leds*sizeof(CRGBA); i++) {
+      r.bytes_touched += (a[i] != b[i]);
+    }
+
+    host_clock_advance(step);
+  }
+
+  r.peak_heap = host_heap_stats().peak - heap_base;
+  delete layer;
+  return r;
+}
+
+
+// returns the fastest time, in ns, to blend the layer once. the fastest of several batches is used
+// because a batch that was interrupted by the host says nothing about the code.
+uint64_t LayerBench::blend(uint8_t rows, uint8_t cols, uint8_t orientation, BlendCase blend_case, uint32_t num_frames, std::vector<CRGB>& out) {
+  const uint32_t batch = 100;
+  uint16_t num_leds = rows*cols;
+
+  ReAnimator* layer = new ReAnimator(rows, cols, orientation);
+  layer->setup(Pattern_t, NO_PATTERN);
+  layer->set_pattern(blend_case == BLEND_XRAY ? XRAY_SPARKLE : NO_PATTERN);
+  for (uint16_t i = 0; i < num_leds; i++) {
+    // a mix of colors and alphas so no pixel is a special case for nblend()
+    uint8_t a = (blend_case == BLEND_OPAQUE) ? 255 : (i*37) & 0xFF;
+    layer->leds[i] = CRGBA(i*7, i*11, i*13, a);
+  }
+  if (blend_case == BLEND_PROXY) {
+    // what setup(Image_t, ...) plus a loaded image with a proxy color would leave behind, minus the loader task
+    layer->layer_type = Image_t;
+    layer->proxy_color_set = true;
+    layer->proxy_color = (CRGB)layer->leds[0];
+    layer->image_dequeued = true;
+    layer->image_loaded = true;
+  }
+  layer->mark_leds_changed();
+
+  uint64_t best = UINT64_MAX;
+  for (uint32_t f = 0; f < num_frames; f += batch) {
+    uint64_t t0 = now_ns();
+    for (uint32_t b = 0; b < batch; b++) {
+      layer->render_span(out.data(), 0, num_leds);
+    }
+    best = min(best, now_ns() - t0);
+  }
+
+  delete layer;
+  return best/batch;
+}
+
+
+static void print_row(const char* kind, const char* name, uint8_t rows, uint8_t cols, uint32_t num_frames, const BenchResult& r) {
+  printf("%-7s %-16s %2ux%-2u %10.0f %10.0f %10llu %8zu %10.1f\n", kind, name, rows, cols,
+         (double)r.run_ns/num_frames, (double)r.blend_ns/num_frames, (unsigned long long)r.worst_ns,
+         r.peak_heap, (double)r.bytes_touched/num_frames);
+}
+
+
+int run_benchmark(uint32_t num_frames, uint32_t step, uint8_t orientation) {
+  if (num_frames == 0) {
+    return 1;
+  }
+
+  bool was_virtual = host_clock_is_virtual();
+  host_clock_use_virtual(true);
+
+  // allocated once up front so they do not count against any layer's heap use
+  std::vector<CRGB> out(32*32);
+  std::vector<CRGBA> before(32*32);
+
+  printf("# %u frames per effect, %u ms per frame, orientation %u\n", num_frames, step, orientation);
+  printf("# run and blend are mean ns/frame. worst is the slowest frame (run + blend) in ns. touched is mean bytes of leds[] changed per frame.\n");
+  printf("%-7s %-16s %-5s %10s %10s %10s %8s %10s\n", "kind", "effect", "size", "run", "blend", "worst", "heap", "touched");
+  printf("# blend rows only blend a layer that does not change, and give the fastest blend in ns.\n");
+
+  for (auto size : bench_sizes) {
+    for (auto p : bench_patterns) {
+      BenchResult r = LayerBench::run(size.rows, size.cols, orientation, BENCH_PATTERN, p.pattern, num_frames, step, out, before);
+      print_row("pattern", p.name, size.rows, size.cols, num_frames, r);
+    }
+    for (auto a : bench_accents) {
+      BenchResult r = LayerBench::run(size.rows, size.cols, orientation, BENCH_ACCENT, a.accent, num_frames, step, out, before);
+      print_row("accent", a.name, size.rows, size.cols, num_frames, r);
+    }
+    for (auto h : bench_headings) {
+      char name[16];
+      snprintf(name, sizeof name, "heading_%u", h);
+      BenchResult r = LayerBench::run(size.rows, size.cols, orientation, BENCH_HEADING, h, num_frames, step, out, before);
+      print_row("move", name, size.rows, size.cols, num_frames, r);
+    }
+    for (auto b : bench_blends) {
+      BenchResult r = {};
+      r.blend_ns = LayerBench::blend(size.rows, size.cols, orientation, b.blend_case, num_frames, out);
+      print_row("blend", b.name, size.rows, size.cols, 1, r);
+    }
+  }
+
+  host_clock_use_virtual(was_virtual);
+  return 0;
+}
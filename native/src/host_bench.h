@@ -0,0 +1,13 @@
+// frame cost benchmark for the native build.
+// every Pattern is run through ReAnimator::run_pattern() and every Accent through ReAnimator::apply_accent()
+// on the virtual clock, so each effect sees the same sequence of millis() values on every run.
+// a few headings are also run on a static layer to show what moving a layer costs in the blend,
+// and a layer for each path through ReAnimator::render_span() is blended on its own.
+#pragma once
+
+#include <stdint.h>
+
+// runs each effect for num_frames frames at 8x8, 16x16, and 32x32 with step ms passing between frames,
+// then prints one row per effect and matrix size to stdout.
+// returns nonzero if there is nothing to run.
+int run_benchmark(uint32_t num_frames, uint32_t step, uint8_t orientation);
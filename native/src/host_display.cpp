@@ -0,0 +1,181 @@
+#include <LittleFS.h>
+
+#include "host_display.h"
+#include "sequence_file.h"
+#include "image_cache.h"
+#include "led_output.h"
+
+static HostDisplay* active_display = nullptr;
+
+
+void host_start_image_loader(void) {
+  static bool started = false;
+  if (!started) {
+    started = true;
+    TaskHandle_t task;
+    xTaskCreatePinnedToCore(ReAnimator::load_image_from_queue, "Task1", 10000, NULL, 1, &task, 0);
+  }
+}
+
+
+HostDisplay::HostDisplay(uint8_t rows, uint8_t cols, uint8_t orient) {
+  num_rows = rows;
+  num_cols = cols;
+  num_leds = rows*cols;
+  orientation = orient;
+  leds = new CRGB[num_leds];
+  memset((void*)leds, 0, num_leds*sizeof(CRGB));
+  tx_leds = new CRGB[num_leds];
+  memset((void*)tx_leds, 0, num_leds*sizeof(CRGB));
+  // same as setup(). the display is driven from the thread that creates it.
+  image_cache_init();
+  image_stats_init();
+  ReAnimator::notify_on_image_load(xTaskGetCurrentTaskHandle());
+  frame_due = 0;
+  frame_error = 0;
+  frame_resynced = false;
+  frames_timed = 0;
+  frames_resynced = 0;
+  frame_error_total = 0;
+  frame_error_max = 0;
+  frames_composited = 0;
+  composite_ns = 0;
+  image_waits = 0;
+  image_wait_ns = 0;
+  frame_waits = 0;
+  sync_images = false;
+  pl_items_shown = 0;
+  schedule_fires = 0;
+  prefetch_enabled = true;
+
+  active_display = this;
+  display_begin(leds, num_rows, num_cols, orientation, {&HostDisplay::image_exists, &HostDisplay::frame_ready});
+  build_missing_sequences(num_leds);
+  FastLED.addLeds(tx_leds, num_leds);
+  led_output_start(tx_leds, num_leds);
+}
+
+
+HostDisplay::~HostDisplay() {
+  unload_layers();
+  led_output_flush();
+  delete[] leds;
+  delete[] tx_leds;
+  if (active_display == this) {
+    active_display = nullptr;
+  }
+}
+
+
+bool HostDisplay::image_exists(String id) {
+  return LittleFS.exists(form_path(F("im"), id, true));
+}
+
+
+void HostDisplay::frame_ready(CRGB* frame, uint16_t num_leds) {
+  HostDisplay* d = active_display;
+  d->composite_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - d->blend_start).count();
+  d->frames_composited++;
+  led_output_send(frame, 255);
+}
+
+
+bool HostDisplay::load(String type, String id) {
+  // as handle_ui_request() in main.cpp
+  playlist_enabled = (type == "pl");
+  return load_file(type, id);
+}
+
+
+bool HostDisplay::images_waiting() {
+  return ReAnimator::images_pending();
+}
+
+
+bool HostDisplay::frames_waiting() {
+  for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+    if (layers[i] != nullptr && layers[i]->sequence_frame_pending()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// what the sync_images wait waits on. a sequence layer reports itself as waiting until reanimate() shows its first frame,
+// so for those it is whether the frame that is due has been read yet.
+bool HostDisplay::loads_pending() {
+  for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+    if (layers[i] == nullptr) {
+      continue;
+    }
+    if (layers[i]->is_sequence() ? layers[i]->sequence_frame_pending() : (layers[i]->get_type() == Image_t && layers[i]->get_image_status() == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool HostDisplay::show() {
+  gwake_time = millis() + MAX_LOOP_SLEEP;
+  if (load_from_playlist()) {
+    pl_items_shown++;
+  }
+
+  // with sync_images the wait comes before the layers are reanimated, so they never see an image that is half way
+  // through loading. whether the loader task beats reanimate() to it would otherwise change the output from run to run.
+  // the same goes for the frames of a sprite sheet animation.
+  image_waits += images_waiting();
+  frame_waits += frames_waiting();
+  if (sync_images && loads_pending()) {
+    // the loader task notifies this thread after every image, so this only wakes up to check when one is done
+    auto t0 = std::chrono::steady_clock::now();
+    while (loads_pending()) {
+      if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5000)) == 0) {
+        break;
+      }
+    }
+    image_wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+  }
+
+  reanimate_layers();
+
+  // the refresh is due at the time blend_layers() gives wake_by()
+  uint32_t due = show_pm + show_refresh_interval + 1;
+  bool resynced = (millis() - (due - 1)) > max(show_refresh_interval, (uint32_t)REFRESH_INTERVAL);
+  blend_start = std::chrono::steady_clock::now();
+  bool refreshed = blend_layers();
+  if (refreshed) {
+    frame_due = due;
+    frame_error = millis() - frame_due;
+    frame_resynced = resynced;
+    if (frame_resynced) {
+      frames_resynced++;
+    }
+    else {
+      frames_timed++;
+      frame_error_total += frame_error;
+      frame_error_max = max(frame_error_max, frame_error);
+    }
+  }
+
+  time_t now = host_time();
+  if (handle_schedule(now)) {
+    schedule_fires++;
+    char at[32];
+    char next[32];
+    struct tm local_now;
+    struct tm local_next;
+    localtime_r(&now, &local_now);
+    localtime_r(&gschedule.next_fire, &local_next);
+    strftime(at, sizeof at, "%a %F %R %Z", &local_now);
+    strftime(next, sizeof next, "%a %F %R %Z", &local_next);
+    fprintf(stderr, "schedule: %s %s pl %s, next at %s\n", at, playlist_enabled ? "loaded" : "could not load",
+            gplaylist.id.c_str(), next);
+  }
+  if (prefetch_enabled) {
+    handle_prefetch();
+  }
+  return refreshed;
+}
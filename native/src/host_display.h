@@ -0,0 +1,72 @@
+// runs the display in display.cpp the way loop() in main.cpp does, with the host clock and output standing in for
+// WiFi, the web server, preferences, and LED power management, and counts what it does for the reports in host_main.cpp.
+#pragma once
+
+#include <chrono>
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "FastLED_RGBA.h"
+#include "display.h"
+
+class HostDisplay {
+  public:
+    uint8_t num_rows;
+    uint8_t num_cols;
+    uint16_t num_leds;
+    uint8_t orientation;
+
+    CRGB* leds;
+    CRGB* tx_leds; // what the output task sends, as in main.cpp
+
+    uint32_t frames_composited; // refreshes where something changed, so the layers were blended and sent to the LEDs
+    uint64_t composite_ns;      // total time spent blending those, from the start of blend_layers() until the frame is ready
+    uint32_t image_waits;       // refreshes that were held up because an image was still loading
+    uint64_t image_wait_ns;     // real time spent waiting on the loader task when sync_images is set
+    uint32_t frame_waits;       // refreshes where the next frame of a sprite sheet animation was due but still loading
+
+    // how late each refresh was. every refresh is due one show_refresh_interval after the last one was due,
+    // unless it fell more than a whole interval (or REFRESH_INTERVAL) behind, in which case it is resynced to when it happened.
+    uint32_t frame_due;         // millis() the last refresh was due
+    uint32_t frame_error;       // ms between frame_due and when the last refresh happened
+    bool frame_resynced;        // the last refresh started over from now, so its error is not counted
+    uint32_t frames_timed;
+    uint32_t frames_resynced;
+    uint64_t frame_error_total;
+    uint32_t frame_error_max;
+
+    uint32_t pl_items_shown;
+    // the schedule runs on host_time(), so with host_clock_set_epoch() rules fire on the virtual clock
+    uint32_t schedule_fires;
+
+    // reads the next playlist item ahead while the current one is shown, as handle_prefetch() does in loop()
+    bool prefetch_enabled;
+
+    // when set, show() waits for the loader task instead of skipping the refresh, so image loads take no time on the virtual clock.
+    // otherwise how many times effects run while an image loads depends on how fast the host reads files.
+    bool sync_images;
+
+    HostDisplay(uint8_t rows, uint8_t cols, uint8_t orient);
+    ~HostDisplay();
+
+    // type is one of im, cm, an, pl, sc (art files under /files) or p for a bare pattern, where id is the Pattern number
+    bool load(String type, String id);
+
+    // one pass of loop(): the playlist, show(), the schedule, then prefetching. returns true if the refresh interval was up,
+    // i.e. leds[] holds the next frame. the frame is only blended again if a layer changed, so it may be the same as the last one.
+    bool show();
+
+    // true while any image layer is still waiting on the loader task
+    bool images_waiting();
+    // true while a sprite sheet animation's next frame is due but still loading
+    bool frames_waiting();
+
+  private:
+    bool loads_pending();
+    std::chrono::steady_clock::time_point blend_start;
+    static bool image_exists(String id);
+    static void frame_ready(CRGB* frame, uint16_t num_leds);
+};
+
+// starts the image loader task. call once before loading any art.
+void host_start_image_loader(void);
@@ -0,0 +1,146 @@
+#include <FastLED.h>
+
+CFastLED FastLED;
+
+uint16_t rand16seed = 1337; // same seed FastLED starts with
+
+
+// FastLED's rainbow hue-to-rgb conversion (hsv2rgb.cpp, hsv2rgb_rainbow) with the yellow boost (Y1) enabled.
+void hsv2rgb_rainbow(const CHSV& hsv, CRGB& rgb) {
+    uint8_t hue = hsv.hue;
+    uint8_t sat = hsv.sat;
+    uint8_t val = hsv.val;
+
+    uint8_t offset = hue & 0x1F; // 0..31
+    uint8_t offset8 = offset << 3;
+    uint8_t third = scale8(offset8, (256 / 3)); // max = 85
+
+    uint8_t r, g, b;
+
+    if (!(hue & 0x80)) {
+        if (!(hue & 0x40)) {
+            if (!(hue & 0x20)) {
+                // 000 R -> O
+                r = 255 - third;
+                g = third;
+                b = 0;
+            }
+            else {
+                // 001 O -> Y
+                r = 171;
+                g = 85 + third;
+                b = 0;
+            }
+        }
+        else {
+            if (!(hue & 0x20)) {
+                // 010 Y -> G
+                uint8_t twothirds = scale8(offset8, ((256 * 2) / 3)); // max=170
+                r = 171 - twothirds;
+                g = 170 + third;
+                b = 0;
+            }
+            else {
+                // 011 G -> A
+                r = 0;
+                g = 255 - third;
+                b = third;
+            }
+        }
+    }
+    else {
+        if (!(hue & 0x40)) {
+            if (!(hue & 0x20)) {
+                // 100 A -> B
+                uint8_t twothirds = scale8(offset8, ((256 * 2) / 3)); // max=170
+                r = 0;
+                g = 171 - twothirds;
+                b = 85 + twothirds;
+            }
+            else {
+                // 101 B -> P
+                r = third;
+                g = 0;
+                b = 255 - third;
+            }
+        }
+        else {
+            if (!(hue & 0x20)) {
+                // 110 P -- K
+                r = 85 + third;
+                g = 0;
+                b = 171 - third;
+            }
+            else {
+                // 111 K -> R
+                r = 170 + third;
+                g = 0;
+                b = 85 - third;
+            }
+        }
+    }
+
+    if (sat != 255) {
+        if (sat == 0) {
+            r = 255; b = 255; g = 255;
+        }
+        else {
+            uint8_t desat = 255 - sat;
+            desat = scale8_video(desat, desat);
+            uint8_t satscale = 255 - desat;
+            if (r) r = scale8(r, satscale) + 1;
+            if (g) g = scale8(g, satscale) + 1;
+            if (b) b = scale8(b, satscale) + 1;
+            r += desat;
+            g += desat;
+            b += desat;
+        }
+    }
+
+    if (val != 255) {
+        val = scale8_video(val, val);
+        if (val == 0) {
+            r = 0; g = 0; b = 0;
+        }
+        else {
+            if (r) r = scale8(r, val) + 1;
+            if (g) g = scale8(g, val) + 1;
+            if (b) b = scale8(b, val) + 1;
+        }
+    }
+
+    rgb.r = r;
+    rgb.g = g;
+    rgb.b = b;
+}
+
+
+// the render path only uses this to derive a hue for the patterns that are hue based,
+// so a plain hexcone conversion scaled to FastLED's 0-255 hue wheel is close enough.
+CHSV rgb2hsv_approximate(const CRGB& rgb) {
+    uint8_t mx = rgb.r > rgb.g ? (rgb.r > rgb.b ? rgb.r : rgb.b) : (rgb.g > rgb.b ? rgb.g : rgb.b);
+    uint8_t mn = rgb.r < rgb.g ? (rgb.r < rgb.b ? rgb.r : rgb.b) : (rgb.g < rgb.b ? rgb.g : rgb.b);
+    uint8_t delta = mx - mn;
+
+    if (mx == 0) {
+        return CHSV(0, 0, 0);
+    }
+
+    uint8_t s = (255 * delta) / mx;
+    if (delta == 0) {
+        return CHSV(0, 0, mx);
+    }
+
+    int16_t h;
+    if (mx == rgb.r) {
+        h = (43 * (rgb.g - rgb.b)) / delta;
+    }
+    else if (mx == rgb.g) {
+        h = 85 + (43 * (rgb.b - rgb.r)) / delta;
+    }
+    else {
+        h = 171 + (43 * (rgb.r - rgb.g)) / delta;
+    }
+
+    return CHSV((uint8_t)h, s, mx);
+}
@@ -0,0 +1,173 @@
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+
+#include "freertos/FreeRTOS.h"
+
+
+struct HostQueue {
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  UBaseType_t length;
+  UBaseType_t item_size;
+};
+
+struct HostTask {
+  std::thread thread;
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notifications = 0;
+};
+
+// the task each thread runs as. the main thread, which stands in for Arduino's loopTask, gets one the first time it asks.
+static thread_local HostTask* current_task = nullptr;
+
+struct HostMutex {
+  std::timed_mutex m;
+};
+
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  HostQueue* q = new HostQueue;
+  q->length = length;
+  q->item_size = item_size;
+  return q;
+}
+
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks_to_wait) {
+  std::unique_lock<std::mutex> lock(q->m);
+  auto has_room = [q] { return q->items.size() < q->length; };
+  if (ticks_to_wait == portMAX_DELAY) {
+    q->cv.wait(lock, has_room);
+  }
+  else if (!q->cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait), has_room)) {
+    return errQUEUE_FULL;
+  }
+  const uint8_t* p = static_cast<const uint8_t*>(item);
+  q->items.emplace_back(p, p + q->item_size);
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* buffer, TickType_t ticks_to_wait) {
+  std::unique_lock<std::mutex> lock(q->m);
+  auto has_item = [q] { return !q->items.empty(); };
+  if (ticks_to_wait == portMAX_DELAY) {
+    q->cv.wait(lock, has_item);
+  }
+  else if (!q->cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait), has_item)) {
+    return pdFALSE;
+  }
+  std::copy(q->items.front().begin(), q->items.front().end(), static_cast<uint8_t*>(buffer));
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lock(q->m);
+  return q->items.size();
+}
+
+
+// core pinning and priorities are meaningless on the host, so every task is just a detached thread.
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return new HostMutex;
+}
+
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+  if (ticks_to_wait == portMAX_DELAY) {
+    semaphore->m.lock();
+    return pdTRUE;
+  }
+  return semaphore->m.try_lock_for(std::chrono::milliseconds(ticks_to_wait)) ? pdTRUE : pdFALSE;
+}
+
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  semaphore->m.unlock();
+  return pdTRUE;
+}
+
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack_depth, void* parameter, UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id) {
+  HostTask* t = new HostTask;
+  t->thread = std::thread([t, task, parameter] {
+    current_task = t;
+    task(parameter);
+  });
+  t->thread.detach();
+  if (created_task) {
+    *created_task = t;
+  }
+  return pdPASS;
+}
+
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+
+TickType_t xTaskGetTickCount(void) {
+  return millis();
+}
+
+
+void vTaskDelayUntil(TickType_t* previous_wake_time, TickType_t time_increment) {
+  TickType_t wake_time = *previous_wake_time + time_increment;
+  int32_t remaining = (int32_t)(wake_time - xTaskGetTickCount());
+  if (remaining > 0) {
+    delay(remaining);
+  }
+  *previous_wake_time = wake_time;
+}
+
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  if (current_task == nullptr) {
+    current_task = new HostTask;
+  }
+  return current_task;
+}
+
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->m);
+  task->notifications++;
+  task->cv.notify_all();
+  return pdPASS;
+}
+
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait) {
+  HostTask* t = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(t->m);
+  auto notified = [t] { return t->notifications > 0; };
+  if (ticks_to_wait == portMAX_DELAY) {
+    t->cv.wait(lock, notified);
+  }
+  else {
+    t->cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait), notified);
+  }
+  uint32_t count = t->notifications;
+  if (count) {
+    t->notifications = clear_count_on_exit ? 0 : count-1;
+  }
+  return count;
+}
+
+
+void vTaskDelete(TaskHandle_t task) {
+  // tasks in this project never return from their loops, so there is nothing to tear down.
+}
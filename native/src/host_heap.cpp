@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+#include "host_heap.h"
+
+// each block carries its size in front of it so delete can account for it without a lookup table.
+// the header is padded to max_align_t so the block handed out keeps malloc's alignment.
+static const size_t header_size = alignof(max_align_t);
+
+static std::atomic<size_t> heap_in_use(0);
+static std::atomic<size_t> heap_peak(0);
+static std::atomic<uint32_t> heap_allocs(0);
+static std::atomic<uint32_t> heap_frees(0);
+
+
+static void* counted_alloc(size_t n) {
+  uint8_t* p = (uint8_t*)malloc(n + header_size);
+  if (!p) {
+    return nullptr;
+  }
+  *(size_t*)p = n;
+
+  size_t now = heap_in_use += n;
+  size_t peak = heap_peak;
+  while (now > peak && !heap_peak.compare_exchange_weak(peak, now)) {}
+  heap_allocs++;
+
+  return p + header_size;
+}
+
+
+static void counted_free(void* ptr) {
+  if (ptr) {
+    uint8_t* p = (uint8_t*)ptr - header_size;
+    heap_in_use -= *(size_t*)p;
+    heap_frees++;
+    free(p);
+  }
+}
+
+
+static void* counted_alloc_or_throw(size_t n) {
+  void* p = counted_alloc(n);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+
+// the nothrow versions have to go through here too (std::stable_sort() uses them for its scratch buffer),
+// or delete would read a header that is not there
+void* operator new(size_t n) { return counted_alloc_or_throw(n); }
+void* operator new[](size_t n) { return counted_alloc_or_throw(n); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return counted_alloc(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return counted_alloc(n); }
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+
+
+HostHeapStats host_heap_stats(void) {
+  return {heap_in_use, heap_peak, heap_allocs, heap_frees};
+}
+
+
+void host_heap_reset_peak(void) {
+  heap_peak = heap_in_use.load();
+  heap_allocs = 0;
+  heap_frees = 0;
+}
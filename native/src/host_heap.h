@@ -0,0 +1,16 @@
+// heap accounting for the native build. every operator new/delete in the program is counted
+// so the benchmark can report how much heap a layer needs, the way ESP.getFreeHeap() would show it on the device.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct HostHeapStats {
+  size_t in_use;      // bytes currently allocated
+  size_t peak;        // high water mark of in_use since the last host_heap_reset_peak()
+  uint32_t allocs;    // number of allocations since the last host_heap_reset_peak()
+  uint32_t frees;
+};
+
+HostHeapStats host_heap_stats(void);
+void host_heap_reset_peak(void);
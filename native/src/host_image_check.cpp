@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <vector>
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <LittleFS.h>
+#include <StreamUtils.h>
+
+#include "FastLED_RGBA.h"
+#include "host_image_check.h"
+#include "image_file.h"
+
+#define CHECK_LEDS 8
+
+// a JSON image and the pixels it decodes to, as 0xAARRGGBB. pixels the image does not cover stay transparent (0).
+struct DecodeCase {
+  const char* name;
+  const char* json;
+  bool ok;
+  uint32_t leds[CHECK_LEDS];
+  bool proxy_color_set;
+  uint32_t proxy_color;
+};
+
+static const DecodeCase decode_cases[] = {
+  // colors go to consecutive LEDs from 0. a hex color with 6 digits leaves alpha 0, as the web pages expect.
+  {"consecutive", "{\"i\":[\"ff0000\",\"00ff00\",\"0000ff\"]}", true,
+   {0x00ff0000, 0x0000ff00, 0x000000ff}, false, 0},
+  {"8 digit hex", "{\"i\":[\"ff000080\",\"01020304\"]}", true,
+   {0x80ff0000, 0x04010203}, false, 0},
+  {"bad hex is black", "{\"i\":[\"fffffff\",\"ffffffffff\",\"ff0000ff\"]}", true,
+   {0, 0, 0xffff0000}, false, 0},
+  {"start index", "{\"i\":[3,\"0000ffff\",\"00ff00ff\"]}", true,
+   {0, 0, 0, 0xff0000ff, 0xff00ff00}, false, 0},
+  {"start/stop range", "{\"i\":[2,5,\"112233ff\",7,\"445566ff\"]}", true,
+   {0, 0, 0xff112233, 0xff112233, 0xff112233, 0, 0, 0xff445566}, false, 0},
+  {"stop before start", "{\"i\":[5,2,\"aabbccdd\"]}", true,
+   {0, 0, 0, 0, 0, 0xddaabbcc}, false, 0},
+  {"negative index", "{\"i\":[-4,\"ffffffff\"]}", true,
+   {0, 0, 0, 0, 0xffffffff}, false, 0},
+  {"range past the end", "{\"i\":[6,100,\"ffffffff\",\"ff0000ff\"]}", true,
+   {0, 0, 0, 0, 0, 0, 0xffffffff, 0xffffffff}, false, 0},
+  {"float is a black pixel", "{\"i\":[1.5,\"ffffffff\"]}", true,
+   {0, 0xffffffff}, false, 0},
+  // arrays of one to four values fill r, g, b, a in order. more than four, or values out of 0-255, are black.
+  {"arrays", "{\"i\":[[1],[1,2],[1,2,3],[1,2,3,4],[1,2,3,4,5],[],[300,-1,\"x\",7],[ 9 , 8 ]]}", true,
+   {0x00010000, 0x00010200, 0x00010203, 0x04010203, 0, 0, 0x07000000, 0x00090800}, false, 0},
+  {"unknown and nested keys", "{\"t\":\"im\",\"x\":{\"a\":[1,{\"b\":[2,3]}],\"c\":null},\"i\":[\"ffffffff\"],\"y\":[true,false,\"]}\"]}", true,
+   {0xffffffff}, false, 0},
+  {"object in i is a black pixel", "{\"i\":[{\"a\":[1]},\"ffffffff\"]}", true,
+   {0, 0xffffffff}, false, 0},
+  {"whitespace", " {\n \"i\" : [ 1 ,\t2 , \"ffffffff\" ] ,\r\n \"pc\" : \"010203\" } ", true,
+   {0, 0xffffffff}, true, 0x010203},
+  {"proxy color before i", "{\"pc\":\"102030\",\"i\":[\"ff0000ff\"]}", true,
+   {0xffff0000}, true, 0x102030},
+  {"proxy color after i", "{\"i\":[\"ff0000ff\"],\"pc\":\"102030\"}", true,
+   {0xffff0000}, true, 0x102030},
+  {"proxy color not a string", "{\"pc\":[1,2,3],\"i\":[\"ff0000ff\"]}", true,
+   {0xffff0000}, false, 0},
+  {"escaped key", "{\"\\u0069\":[\"ffffffff\"],\"\\\"\":1}", true,
+   {}, false, 0},
+  {"empty object", "{}", true, {}, false, 0},
+  {"empty i", "{\"i\":[]}", true, {}, false, 0},
+  // malformed input fails. what was decoded before the error is left in leds[].
+  {"top level array", "[\"ffffffff\"]", false, {}, false, 0},
+  {"empty input", "", false, {}, false, 0},
+  {"ends early", "{\"i\":[\"ffffffff\",\"ff00", false, {0xffffffff}, false, 0},
+  {"no closing brace", "{\"i\":[\"ffffffff\"]", false, {0xffffffff}, false, 0},
+  {"trailing comma", "{\"i\":[1,2,]}", false, {}, false, 0},
+  {"missing comma", "{\"i\":[1 2]}", false, {}, false, 0},
+  {"unquoted key", "{i:[\"ffffffff\"]}", false, {}, false, 0},
+  {"missing colon", "{\"i\" [\"ffffffff\"]}", false, {}, false, 0},
+  {"too deeply nested", "{\"x\":[[[[[[[[[[[[1]]]]]]]]]]]],\"i\":[\"ffffffff\"]}", false, {}, false, 0},
+};
+
+
+// lets decode_image_json() read a string
+class CheckStream : public Stream {
+    const char* m_p;
+
+  public:
+    CheckStream(const char* s) : m_p(s) {}
+
+    int available() { return strlen(m_p); }
+    int read() { return *m_p ? (uint8_t)*m_p++ : -1; }
+    int peek() { return *m_p ? (uint8_t)*m_p : -1; }
+    size_t write(uint8_t) { return 0; }
+};
+
+
+static uint32_t failures = 0;
+static uint32_t checks = 0;
+
+
+static void check(bool passed, const char* what, const char* name) {
+  checks++;
+  if (!passed) {
+    failures++;
+    printf("FAIL %s: %s\n", what, name);
+  }
+}
+
+
+static bool same_pixels(const CRGBA* a, const CRGBA* b, uint16_t num_leds) {
+  return memcmp((const void*)a, (const void*)b, num_leds*sizeof(CRGBA)) == 0;
+}
+
+
+static void check_decoder(void) {
+  for (const DecodeCase& dc : decode_cases) {
+    CRGBA leds[CHECK_LEDS];
+    bool proxy_color_set = true;
+    CRGB proxy_color = CRGB::Black;
+    CheckStream in(dc.json);
+    bool ok = decode_image_json(in, leds, CHECK_LEDS, &proxy_color_set, &proxy_color);
+    check(ok == dc.ok, "decode result", dc.name);
+
+    bool pixels_match = true;
+    for (uint16_t i = 0; i < CHECK_LEDS; i++) {
+      if ((uint32_t)leds[i] != dc.leds[i]) {
+        pixels_match = false;
+        printf("  led %u is %08x, expected %08x\n", i, (uint32_t)leds[i], dc.leds[i]);
+      }
+    }
+    check(pixels_match, "decoded pixels", dc.name);
+    if (dc.ok) {
+      check(proxy_color_set == dc.proxy_color_set && (!dc.proxy_color_set || proxy_color == CRGB(dc.proxy_color)), "proxy color", dc.name);
+    }
+  }
+}
+
+
+// a small generator so every run checks the same images
+static uint32_t check_seed = 1;
+static uint32_t check_random(void) {
+  check_seed = check_seed*1103515245 + 12345;
+  return check_seed >> 8;
+}
+
+
+// runs of colors picked from a palette of num_colors, with runs up to max_run long.
+// if there are at least as many colors as pixels every pixel gets its own.
+static std::vector<CRGBA> check_image(uint16_t num_leds, uint32_t num_colors, uint16_t max_run) {
+  std::vector<CRGBA> palette(num_colors);
+  for (uint32_t c = 0; c < num_colors; c++) {
+    // distinct as long as there are fewer than 2^24 colors
+    palette[c] = CRGBA(c >> 16, c >> 8, c, check_random());
+  }
+  std::vector<CRGBA> leds(num_leds);
+  uint16_t i = 0;
+  if (num_colors >= num_leds) {
+    std::copy(palette.begin(), palette.begin() + num_leds, leds.begin());
+    return leds;
+  }
+  while (i < num_leds) {
+    CRGBA color = palette[check_random() % num_colors];
+    uint16_t run = 1 + check_random() % max_run;
+    for (uint16_t r = 0; r < run && i < num_leds; r++) {
+      leds[i++] = color;
+    }
+  }
+  return leds;
+}
+
+
+static void check_pack(void) {
+  struct {
+    const char* name;
+    uint16_t num_leds;
+    uint32_t num_colors;
+    uint16_t max_run;
+    bool packs;
+  } pack_cases[] = {
+    {"one color", 1024, 1, 1024, true},
+    {"runs longer than one packed run", 1024, 3, 400, true},
+    {"few colors, short runs", 256, 4, 3, true},
+    {"every pixel different", 256, 256, 1, false},
+    {"256 colors in runs", 1024, 256, 8, true},
+    {"more than 256 colors", 1024, 1024, 1, false},
+  };
+
+  for (auto& pc : pack_cases) {
+    std::vector<CRGBA> leds = check_image(pc.num_leds, pc.num_colors, pc.max_run);
+    size_t pixel_bytes = pc.num_leds*sizeof(CRGBA);
+    std::vector<uint8_t> packed(pixel_bytes);
+    // as write_image_bin() does, packed pixels are only kept when they are smaller
+    size_t size = pack_image(leds.data(), pc.num_leds, packed.data(), pixel_bytes - 1);
+    check((size != 0) == pc.packs, "packed or not as expected", pc.name);
+    if (size == 0) {
+      continue;
+    }
+
+    std::vector<CRGBA> unpacked(pc.num_leds);
+    check(unpack_image(packed.data(), size, unpacked.data(), pc.num_leds) && same_pixels(leds.data(), unpacked.data(), pc.num_leds),
+          "pack/unpack round trip", pc.name);
+    check(!unpack_image(packed.data(), size-1, unpacked.data(), pc.num_leds), "truncated packed pixels rejected", pc.name);
+    check(!unpack_image(packed.data(), size, unpacked.data(), pc.num_leds-1), "wrong number of pixels rejected", pc.name);
+    check(pack_image(leds.data(), pc.num_leds, packed.data(), size-1) == 0, "packing into too little room fails", pc.name);
+  }
+}
+
+
+static void check_json_round_trip(void) {
+  const String json_path = "/image_check.json";
+  const String bin_path = "/image_check" IMAGE_BIN_EXT;
+  struct {
+    const char* name;
+    uint16_t num_leds;
+    uint32_t num_colors;
+    uint16_t max_run;
+    bool proxy_color_set;
+  } json_cases[] = {
+    {"runs and single pixels", 256, 6, 4, false},
+    {"one color", 1024, 1, 1024, true},
+    {"every pixel different", 1024, 1024, 1, true},
+  };
+
+  for (auto& jc : json_cases) {
+    std::vector<CRGBA> leds = check_image(jc.num_leds, jc.num_colors, jc.max_run);
+    CRGB proxy_color = CRGB(check_random());
+    check(write_image_json(json_path, leds.data(), jc.num_leds, jc.proxy_color_set, proxy_color), "write_image_json()", jc.name);
+
+    std::vector<CRGBA> decoded(jc.num_leds);
+    bool proxy_color_set = !jc.proxy_color_set;
+    CRGB decoded_proxy_color = CRGB::Black;
+    File file = LittleFS.open(json_path, "r");
+    ReadBufferingStream bufferedFile(file, 64);
+    bool ok = file && decode_image_json(bufferedFile, decoded.data(), jc.num_leds, &proxy_color_set, &decoded_proxy_color);
+    if (file) {
+      file.close();
+    }
+    check(ok && same_pixels(leds.data(), decoded.data(), jc.num_leds) && proxy_color_set == jc.proxy_color_set &&
+          (!jc.proxy_color_set || decoded_proxy_color == proxy_color), "write_image_json() round trip", jc.name);
+
+    // what a JSON image saved from the web pages goes through
+    std::fill(decoded.begin(), decoded.end(), CRGBA(0));
+    proxy_color_set = !jc.proxy_color_set;
+    ok = convert_image_json(json_path, bin_path, jc.num_leds) &&
+         read_image_bin(bin_path, decoded.data(), jc.num_leds, &proxy_color_set, &decoded_proxy_color);
+    check(ok && same_pixels(leds.data(), decoded.data(), jc.num_leds) && proxy_color_set == jc.proxy_color_set &&
+          (!jc.proxy_color_set || decoded_proxy_color == proxy_color), "convert_image_json() round trip", jc.name);
+    check(is_image_bin(bin_path, jc.num_leds) && !is_image_bin(bin_path, jc.num_leds+1), "is_image_bin()", jc.name);
+  }
+  LittleFS.remove(json_path);
+  LittleFS.remove(bin_path);
+}
+
+
+int run_image_check(void) {
+  check_decoder();
+  check_pack();
+  check_json_round_trip();
+  printf("# %u of %u image checks failed\n", failures, checks);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+// checks for the image formats in the native build.
+// decodes JSON images that cover each case deserializeSegmentStream() handles and compares the pixels against what
+// the old ArduinoJson based decoder gave, then round trips images through pack_image()/unpack_image(),
+// write_image_json(), and convert_image_json().
+#pragma once
+
+#include <stdint.h>
+
+// LittleFS must already be started, since the round trips write a file to its root and remove it after.
+// prints a line to stdout for each check that failed. returns nonzero if any did.
+int run_image_check(void);
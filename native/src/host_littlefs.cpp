@@ -0,0 +1,182 @@
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <LittleFS.h>
+
+HostLittleFS LittleFS;
+
+
+File::File(const String& path, const String& host_path, const char* mode) : m_path(path), m_host_path(host_path) {
+  struct stat st;
+  if (stat(host_path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    m_dir = opendir(host_path.c_str());
+    return;
+  }
+  m_fp = fopen(host_path.c_str(), (mode[0] == 'r') ? "rb" : (mode[0] == 'a') ? "ab" : "wb");
+}
+
+
+File::File(File&& other) {
+  *this = std::move(other);
+}
+
+
+File& File::operator=(File&& other) {
+  if (this != &other) {
+    close();
+    m_fp = other.m_fp;
+    m_dir = other.m_dir;
+    m_path = other.m_path;
+    m_host_path = other.m_host_path;
+    other.m_fp = nullptr;
+    other.m_dir = nullptr;
+  }
+  return *this;
+}
+
+
+File::~File() {
+  close();
+}
+
+
+int File::available() {
+  if (!m_fp) {
+    return 0;
+  }
+  long pos = ftell(m_fp);
+  return (int)(size() - pos);
+}
+
+
+int File::read() {
+  return m_fp ? fgetc(m_fp) : -1;
+}
+
+
+int File::peek() {
+  if (!m_fp) {
+    return -1;
+  }
+  int c = fgetc(m_fp);
+  if (c != EOF) {
+    ungetc(c, m_fp);
+  }
+  return c;
+}
+
+
+size_t File::readBytes(char* buffer, size_t length) {
+  return m_fp ? fread(buffer, 1, length, m_fp) : 0;
+}
+
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  return m_fp ? fwrite(buffer, 1, size, m_fp) : 0;
+}
+
+
+bool File::seek(uint32_t pos) {
+  return m_fp && fseek(m_fp, pos, SEEK_SET) == 0;
+}
+
+
+size_t File::position() {
+  return m_fp ? ftell(m_fp) : 0;
+}
+
+
+size_t File::size() {
+  if (!m_fp) {
+    return 0;
+  }
+  struct stat st;
+  fflush(m_fp);
+  if (fstat(fileno(m_fp), &st) != 0) {
+    return 0;
+  }
+  return st.st_size;
+}
+
+
+void File::close() {
+  if (m_fp) {
+    fclose(m_fp);
+    m_fp = nullptr;
+  }
+  if (m_dir) {
+    closedir((DIR*)m_dir);
+    m_dir = nullptr;
+  }
+}
+
+
+const char* File::name() const {
+  // like LittleFS on the ESP32, name() is just the last path component
+  int i = m_path.lastIndexOf('/');
+  return m_path.c_str() + i + 1;
+}
+
+
+File File::openNextFile() {
+  if (!m_dir) {
+    return File();
+  }
+  while (struct dirent* entry = readdir((DIR*)m_dir)) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    String child = m_path;
+    if (!child.endsWith("/")) {
+      child += "/";
+    }
+    child += entry->d_name;
+    return File(child, LittleFS.host_path(child), "r");
+  }
+  return File();
+}
+
+
+bool HostLittleFS::begin(const char* host_root) {
+  if (host_root) {
+    m_root = host_root;
+  }
+  struct stat st;
+  return stat(m_root.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+String HostLittleFS::host_path(const String& path) const {
+  String hp = m_root;
+  if (!path.startsWith("/")) {
+    hp += "/";
+  }
+  hp += path;
+  return hp;
+}
+
+
+File HostLittleFS::open(const String& path, const char* mode) {
+  return File(path, host_path(path), mode);
+}
+
+
+bool HostLittleFS::exists(const String& path) {
+  struct stat st;
+  return stat(host_path(path).c_str(), &st) == 0;
+}
+
+
+bool HostLittleFS::remove(const String& path) {
+  return ::remove(host_path(path).c_str()) == 0;
+}
+
+
+bool HostLittleFS::rename(const String& from, const String& to) {
+  return ::rename(host_path(from).c_str(), host_path(to).c_str()) == 0;
+}
+
+
+bool HostLittleFS::mkdir(const String& path) {
+  return ::mkdir(host_path(path).c_str(), 0755) == 0;
+}
@@ -0,0 +1,271 @@
+// headless renderer for the native build. runs the same layer and compositing code as the firmware
+// and writes every refreshed frame as PPM (P6) or raw RGB24 so the render path can be profiled and
+// regression tested on a workstation.
+//
+// examples:
+//   .pio/build/native/program -n 50 -O frames/mona im mona
+//   .pio/build/native/program -r 32 -c 32 -f raw cm cm_example | ffplay -f rawvideo -pixel_format rgb24 -video_size 32x32 -
+//   .pio/build/native/program -B -n 2000 -t 1
+//   .pio/build/native/program -E 1792137600 -z EST5EDT,M3.2.0,M11.1.0 -t 60000 -n 10080 -O /dev/null sc schedule
+//   .pio/build/native/program -I
+#include <getopt.h>
+
+#include <LittleFS.h>
+
+#include "host_bench.h"
+#include "host_soak.h"
+#include "host_sequence_check.h"
+#include "host_image_check.h"
+#include "host_display.h"
+#include "led_output.h"
+#include "image_cache.h"
+#include "image_stats.h"
+
+enum FrameFormat {PPM, RAW};
+
+
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "usage: %s [options] <type> <id>\n"
+          "       %s -B [-n frames] [-t ms] [-o orientation]\n"
+          "       %s -L [-n cycles] [options] pl <id>\n"
+          "       %s -A [-n frames] [options] an <id>\n"
+          "       %s -I [-d dir]\n"
+          "  type is im, cm, an, pl, or sc for art under <data dir>/files, or p for a single pattern where id is its number\n"
+          "  -r rows        matrix rows (default %d)\n"
+          "  -c cols        matrix columns (default %d)\n"
+          "  -o orientation 0 native, 1 rotated 90 degrees counterclockwise (default %d)\n"
+          "  -d dir         host directory standing in for the LittleFS root (default data_free)\n"
+          "  -n frames      number of frames to write (default 100, or 1000 per effect with -B)\n"
+          "  -t ms          time that passes per loop() iteration (default 10)\n"
+          "  -S             sleep until the next layer or frame deadline after each iteration, like loop() does, instead of -t\n"
+          "  -f format      ppm or raw (default ppm)\n"
+          "  -O output      prefix for numbered frame files, or - for stdout (default -)\n"
+          "  -R             use the real clock instead of the virtual clock\n"
+          "  -P             do not read the next playlist item ahead\n"
+          "  -E seconds     start the wall clock at this Unix time and advance it with the clock in use, so schedules can be run on the virtual clock\n"
+          "  -z tz          POSIX time zone as setup() passes to configTzTime(), e.g. EST5EDT,M3.2.0,M11.1.0 (default TZ from the environment)\n"
+          "  -T file        write when each frame was due, when it was shown, and the difference in ms to file, or - for stderr\n"
+          "  -B             benchmark every pattern and accent at 8x8, 16x16, and 32x32 instead of rendering\n"
+          "  -L             soak test: change playlist items n times (default 1000000) as fast as possible and report on the heap\n"
+          "  -A             check that each frame of a sprite sheet animation is shown for the duration in its .anim file, over n frames\n"
+          "  -I             check the JSON image decoder, image packing, and the JSON and binary image writers against known images\n",
+          prog, prog, prog, prog, prog, DEFAULT_NUM_ROWS, DEFAULT_NUM_COLS, DEFAULT_ORIENTATION);
+}
+
+
+static bool write_frame(const CRGB* leds, uint16_t num_leds, uint8_t rows, uint8_t cols, FrameFormat format, const char* output, uint32_t frame_number) {
+  FILE* fp = stdout;
+  if (strcmp(output, "-") != 0) {
+    char fname[512];
+    snprintf(fname, sizeof fname, "%s_%05u.%s", output, frame_number, (format == PPM) ? "ppm" : "rgb");
+    fp = fopen(fname, "wb");
+    if (!fp) {
+      fprintf(stderr, "could not open %s\n", fname);
+      return false;
+    }
+  }
+
+  if (format == PPM) {
+    fprintf(fp, "P6\n%u %u\n255\n", cols, rows);
+  }
+
+  // leds[] is in strip (serpentine) order. unwind it so the image is in row-major order like the matrix appears.
+  for (uint8_t y = 0; y < rows; y++) {
+    for (uint8_t x = 0; x < cols; x++) {
+      uint16_t i = (y % 2) ? (cols*y + cols-1) - x : cols*y + x;
+      fwrite(leds[i].raw, 1, 3, fp);
+    }
+  }
+
+  if (fp != stdout) {
+    fclose(fp);
+  }
+  else {
+    fflush(fp);
+  }
+  return true;
+}
+
+
+int main(int argc, char* argv[]) {
+  uint8_t rows = DEFAULT_NUM_ROWS;
+  uint8_t cols = DEFAULT_NUM_COLS;
+  uint8_t orientation = DEFAULT_ORIENTATION;
+  const char* data_dir = "data_free";
+  uint32_t num_frames = 0;
+  uint32_t step = 10;
+  FrameFormat format = PPM;
+  const char* output = "-";
+  bool virtual_clock = true;
+  bool benchmark = false;
+  bool soak = false;
+  bool sequence_check = false;
+  bool image_check = false;
+  bool scheduled = false;
+  bool prefetch = true;
+  const char* timing_output = nullptr;
+  time_t epoch = 0;
+  const char* posix_tz = nullptr;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:c:o:d:n:t:f:O:T:E:z:RSPBLAIh")) != -1) {
+    switch (opt) {
+      case 'r': rows = atoi(optarg); break;
+      case 'c': cols = atoi(optarg); break;
+      case 'o': orientation = atoi(optarg); break;
+      case 'd': data_dir = optarg; break;
+      case 'n': num_frames = strtoul(optarg, nullptr, 10); break;
+      case 't': step = strtoul(optarg, nullptr, 10); break;
+      case 'f': format = (strcmp(optarg, "raw") == 0) ? RAW : PPM; break;
+      case 'O': output = optarg; break;
+      case 'R': virtual_clock = false; break;
+      case 'S': scheduled = true; break;
+      case 'P': prefetch = false; break;
+      case 'T': timing_output = optarg; break;
+      case 'E': epoch = strtoll(optarg, nullptr, 10); break;
+      case 'z': posix_tz = optarg; break;
+      case 'B': benchmark = true; break;
+      case 'L': soak = true; break;
+      case 'A': sequence_check = true; break;
+      case 'I': image_check = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+
+  if (benchmark) {
+    return run_benchmark(num_frames ? num_frames : 1000, step, orientation);
+  }
+
+  if (image_check) {
+    if (!LittleFS.begin(data_dir)) {
+      fprintf(stderr, "%s is not a directory\n", data_dir);
+      return 1;
+    }
+    return run_image_check();
+  }
+
+  if (num_frames == 0) {
+    num_frames = soak ? 1000000 : 100;
+  }
+
+  if (argc - optind != 2 || rows == 0 || cols == 0 || rows > 32 || cols > 32) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (!LittleFS.begin(data_dir)) {
+    fprintf(stderr, "%s is not a directory\n", data_dir);
+    return 1;
+  }
+
+  host_clock_use_virtual(virtual_clock);
+  if (virtual_clock) {
+    // some effects compare against absolute times (e.g. the first frozen decay happens 7 s after boot),
+    // so start from the same time on every run
+    host_clock_set(0);
+  }
+  if (epoch) {
+    host_clock_set_epoch(epoch - millis()/1000);
+  }
+  if (posix_tz) {
+    configTzTime(posix_tz, "pool.ntp.org");
+  }
+  host_start_image_loader();
+
+  HostDisplay display(rows, cols, orientation);
+  display.sync_images = virtual_clock;
+  display.prefetch_enabled = prefetch;
+  if (!display.load(argv[optind], argv[optind+1])) {
+    fprintf(stderr, "could not load %s %s\n", argv[optind], argv[optind+1]);
+    return 1;
+  }
+  if (soak) {
+    if (run_soak(display, num_frames) != 0) {
+      fprintf(stderr, "-L needs a playlist\n");
+      return 1;
+    }
+    return 0;
+  }
+  if (sequence_check) {
+    if (!virtual_clock) {
+      fprintf(stderr, "-A needs the virtual clock\n");
+      return 1;
+    }
+    return run_sequence_check(display, argv[optind+1], num_frames);
+  }
+
+  FILE* timing_fp = nullptr;
+  if (timing_output != nullptr) {
+    timing_fp = (strcmp(timing_output, "-") == 0) ? stderr : fopen(timing_output, "w");
+    if (!timing_fp) {
+      fprintf(stderr, "could not open %s\n", timing_output);
+      return 1;
+    }
+    fprintf(timing_fp, "frame,due,shown,error\n");
+  }
+
+  uint32_t written = 0;
+  uint32_t passes = 0;
+  while (written < num_frames) {
+    passes++;
+    if (display.show()) {
+      if (!write_frame(display.leds, display.num_leds, rows, cols, format, output, written)) {
+        return 1;
+      }
+      if (timing_fp) {
+        // a resynced frame was due whenever it happened, so its error is left blank
+        if (display.frame_resynced) {
+          fprintf(timing_fp, "%u,%u,%u,\n", written, display.frame_due, display.frame_due + display.frame_error);
+        }
+        else {
+          fprintf(timing_fp, "%u,%u,%u,%u\n", written, display.frame_due, display.frame_due + display.frame_error, display.frame_error);
+        }
+      }
+      written++;
+    }
+
+    if (display.images_waiting()) {
+      // the loader runs in real time, so hold the virtual clock still until it catches up.
+      // otherwise how far animations advance would depend on how fast the host reads files.
+      if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5000)) == 0) {
+        fprintf(stderr, "timed out waiting for images to load\n");
+        return 1;
+      }
+      continue;
+    }
+    if (scheduled) {
+      TickType_t pass_start = xTaskGetTickCount();
+      int32_t sleep_ms = (int32_t)(gwake_time - pass_start);
+      if (sleep_ms > 0) {
+        vTaskDelayUntil(&pass_start, pdMS_TO_TICKS(sleep_ms));
+      }
+    }
+    else {
+      delay(step);
+    }
+  }
+
+  led_output_flush();
+  if (timing_fp && timing_fp != stderr) {
+    fclose(timing_fp);
+  }
+  fprintf(stderr, "%u frames, %u blended, %u transmitted, %.0f ns per composite\n", written, display.frames_composited,
+          FastLED.get_show_count(), display.frames_composited ? (double)display.composite_ns/display.frames_composited : 0.0);
+  fprintf(stderr, "%u passes over %u ms\n", passes, millis());
+  if (playlist_enabled) {
+    fprintf(stderr, "%u playlist items shown\n", display.pl_items_shown);
+  }
+  if (!gschedule.schedule.rules.empty()) {
+    fprintf(stderr, "%u schedule rules fired\n", display.schedule_fires);
+  }
+  fprintf(stderr, "%u refreshes waited on images and %u on animation frames for %.3f ms\n", display.image_waits,
+          display.frame_waits, display.image_wait_ns/1e6);
+  fprintf(stderr, "frame timing: %u frames late by %.2f ms on average and %u ms at most, %u resynced\n", display.frames_timed,
+          display.frames_timed ? (double)display.frame_error_total/display.frames_timed : 0.0, display.frame_error_max, display.frames_resynced);
+  fprintf(stderr, "%s", image_stats_summary().c_str());
+  ImageCacheStats cache = image_cache_stats();
+  fprintf(stderr, "image cache: %u hits, %u misses, %u evictions, %u images in %zu of %zu bytes\n", cache.hits, cache.misses,
+          cache.evictions, cache.entries, cache.bytes, cache.budget);
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <vector>
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "FastLED_RGBA.h"
+#include "host_sequence_check.h"
+#include "sequence_file.h"
+
+int run_sequence_check(HostDisplay& display, const String& id, uint32_t num_frames) {
+  if (art_type != "sq" || num_frames == 0) {
+    fprintf(stderr, "-A needs a sprite sheet animation\n");
+    return 1;
+  }
+
+  String bin_path = sequence_bin_path(form_path(F("an"), id, true));
+  uint16_t num_sequence_frames = read_sequence_bin_header(bin_path, display.num_leds);
+  std::vector<uint32_t> durations;
+  std::vector<CRGBA> pixels(display.num_leds);
+  for (uint16_t f = 0; f < num_sequence_frames; f++) {
+    bool proxy_color_set;
+    CRGB proxy_color;
+    uint32_t duration = 0;
+    if (read_sequence_frame(bin_path, f, pixels.data(), display.num_leds, &proxy_color_set, &proxy_color, &duration)) {
+      // broken frames are skipped when played
+      durations.push_back(max(duration, (uint32_t)1));
+    }
+  }
+  if (durations.empty()) {
+    fprintf(stderr, "could not read the frames of %s\n", bin_path.c_str());
+    return 1;
+  }
+
+  printf("# %s: %zu frames. each frame change is compared against the duration of the frame before it.\n", id.c_str(), durations.size());
+  printf("%8s %8s %8s %8s\n", "change", "shown", "expected", "error");
+
+  // every frame of a sequence is a change, so each blend is the next frame going up
+  uint32_t blends = display.frames_composited;
+  uint32_t last_change = 0;
+  uint32_t changes = 0;
+  uint32_t off = 0;
+  uint32_t worst = 0;
+  bool first = true;
+  uint32_t give_up = millis() + num_frames*(*std::max_element(durations.begin(), durations.end()) + REFRESH_INTERVAL);
+  while (changes < num_frames && (int32_t)(millis() - give_up) < 0) {
+    display.show();
+    if (display.frames_composited != blends) {
+      blends = display.frames_composited;
+      if (!first) {
+        uint32_t shown = millis() - last_change;
+        uint32_t expected = durations[changes % durations.size()];
+        uint32_t error = (shown > expected) ? shown - expected : expected - shown;
+        worst = max(worst, error);
+        if (error > 1) {
+          printf("%8u %8u %8u %8u\n", changes, shown, expected, error);
+          off++;
+        }
+        changes++;
+      }
+      first = false;
+      last_change = millis();
+    }
+    host_clock_advance(1);
+  }
+
+  printf("# %u of %u frame changes were off by more than 1 ms, %u ms at most\n", off, changes, worst);
+  return (off > 0 || changes < num_frames) ? 1 : 0;
+}
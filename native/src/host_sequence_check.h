@@ -0,0 +1,13 @@
+// timing check for sprite sheet animations in the native build.
+// plays a sequence on the virtual clock one ms at a time and compares how long each frame stayed up
+// against the duration stored for it in the sequence's binary file.
+#pragma once
+
+#include <stdint.h>
+
+#include "host_display.h"
+
+// display must already have the sequence id loaded with load("an", id). checks num_frames frame changes and prints a row
+// to stdout for each one that was off. returns nonzero if the layer is not playing a sequence, or if any frame was off
+// by more than 1 ms or the frames stopped changing.
+int run_sequence_check(HostDisplay& display, const String& id, uint32_t num_frames);
@@ -0,0 +1,77 @@
+#include <malloc.h>
+
+#include <Arduino.h>
+
+#include "host_soak.h"
+#include "host_heap.h"
+
+struct SoakRow {
+  HostHeapStats heap;
+  size_t arena;     // bytes glibc has taken from the system for its heap
+  size_t arena_free; // bytes of that which are free, i.e. room that is only usable by blocks that fit between the ones in use
+  uint8_t pool_in_use;
+  uint32_t heap_layers;
+};
+
+
+static SoakRow soak_row(void) {
+  SoakRow row;
+  row.heap = host_heap_stats();
+  struct mallinfo2 mi = mallinfo2();
+  row.arena = mi.arena;
+  row.arena_free = mi.fordblks;
+  uint8_t slots;
+  ReAnimator::layer_pool_stats(slots, row.pool_in_use, row.heap_layers);
+  return row;
+}
+
+
+// moves the playlist on to its next item on the next show(), however long the current one was meant to be shown
+static void next_item(HostDisplay& display) {
+  pl_item_loop_countdown = 0;
+  host_clock_advance(gplaylist.item_interval + 1);
+  display.show();
+}
+
+
+int run_soak(HostDisplay& display, uint32_t num_cycles) {
+  if (!playlist_enabled || num_cycles == 0) {
+    return 1;
+  }
+
+  // one trip around the playlist first fills the image cache and the buffers that only grow,
+  // so what is left over afterwards is what the firmware would keep taking
+  uint32_t warm_up = gplaylist.playlist.items.size();
+  for (uint32_t c = 0; c < warm_up; c++) {
+    next_item(display);
+  }
+
+  uint8_t slots, in_use;
+  uint32_t on_heap;
+  ReAnimator::layer_pool_stats(slots, in_use, on_heap);
+  printf("# %u item changes after %u to warm up. layer pool has %u slots.\n", num_cycles, warm_up, slots);
+  printf("# in use is bytes allocated with new. allocs is new calls per item change since the last row.\n");
+  printf("# arena and free are glibc's heap and the free bytes inside it. frag is free/arena.\n");
+  printf("%10s %10s %10s %8s %10s %10s %6s %6s %6s\n", "cycle", "in_use", "peak", "allocs", "arena", "free", "frag", "layers", "heap");
+
+  host_heap_reset_peak();
+  SoakRow first = soak_row();
+  uint32_t step = max(num_cycles/10, (uint32_t)1);
+  uint32_t last_cycle = 0;
+  for (uint32_t c = 1; c <= num_cycles; c++) {
+    next_item(display);
+    if (c % step == 0 || c == num_cycles) {
+      SoakRow row = soak_row();
+      printf("%10u %10zu %10zu %8.2f %10zu %10zu %5.1f%% %6u %6u\n", c, row.heap.in_use, row.heap.peak,
+             (double)row.heap.allocs/(c - last_cycle), row.arena, row.arena_free,
+             row.arena ? 100.0*row.arena_free/row.arena : 0.0, row.pool_in_use, row.heap_layers - first.heap_layers);
+      host_heap_reset_peak();
+      last_cycle = c;
+    }
+  }
+
+  SoakRow last = soak_row();
+  printf("# bytes in use went from %zu to %zu. %u layers did not fit the pool.\n", first.heap.in_use, last.heap.in_use,
+         last.heap_layers - first.heap_layers);
+  return 0;
+}
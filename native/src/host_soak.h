@@ -0,0 +1,13 @@
+// heap soak test for the native build.
+// steps a playlist from item to item as fast as it will go, the way days of playlist cycling would on the device,
+// and reports whether the heap holds up: allocations per item change, bytes still in use, and how much of glibc's heap
+// is free but stuck between blocks that are in use.
+#pragma once
+
+#include <stdint.h>
+
+#include "host_display.h"
+
+// display must already have a playlist loaded. runs num_cycles item changes and prints a row every tenth of the way
+// to stdout. returns nonzero if no playlist is loaded.
+int run_soak(HostDisplay& display, uint32_t num_cycles);
@@ -24,11 +24,15 @@
 #include <FastLED.h>
 #include <LittleFS.h>
 #include <time.h>
+#include <cstddef>
 
 #include "FastLED_RGBA.h"
 #include "ReAnimator.h"
 #include "ArduinoJson-v6.h"
-#include "JSON_Image_Decoder.h"
+#include "image_file.h"
+#include "image_cache.h"
+#include "sequence_file.h"
+#include "image_stats.h"
 #include <StreamUtils.h>
 
 
@@ -49,6 +53,17 @@ extern lv_font_t font_small;
 // set queue size to NUM_LAYERS+1 because every layer of a composite could be an image, with the +1 for a little safety margin
 // since xQueueSend has xTicksToWait set to 0 (i.e. do not wait for empty queue slot if queue is full).
 QueueHandle_t ReAnimator::qimages = xQueueCreate(NUM_LAYERS+1, sizeof(Image));
+TaskHandle_t ReAnimator::image_notify_task = nullptr;
+ReAnimator::PrefetchSlot ReAnimator::prefetch_slot;
+ReAnimator::SequenceSlot ReAnimator::seq_slots[SEQUENCE_BUFFER_FRAMES];
+ReAnimator::ImageBatch ReAnimator::image_batch;
+ReAnimator::LayerSlot* ReAnimator::layer_slots = nullptr;
+uint8_t ReAnimator::num_layer_slots = 0;
+uint16_t ReAnimator::layer_slot_leds = 0;
+uint32_t ReAnimator::layer_slot_releases = 0;
+uint32_t ReAnimator::heap_layers = 0;
+lv_draw_buf_t ReAnimator::glyph_draw_buf = {};
+std::atomic<uint16_t> ReAnimator::pending_images(0);
 
 inline void cb_dbg_print(uint32_t i) {
   DEBUG_PRINTLN(i);
@@ -64,8 +79,25 @@ ReAnimator::ReAnimator(uint8_t num_rows, uint8_t num_cols, uint8_t orientation)
     MTX_NUM_LEDS = num_rows*num_cols;
     MTX_ORIENTATION = orientation;
 
+    layer_slot = nullptr;
+    for (uint8_t i = 0; i < num_layer_slots; i++) {
+        if (layer_slots[i].object == this && MTX_NUM_LEDS == layer_slot_leds) {
+            layer_slot = &layer_slots[i];
+        }
+    }
+
     // abort() is called if out of memory so no point in trying to check?
-    leds = new CRGBA[MTX_NUM_LEDS];
+    leds = layer_slot ? layer_slot->leds : new CRGBA[MTX_NUM_LEDS];
+    pixel_map = layer_slot ? layer_slot->pixel_map : new uint16_t[MTX_NUM_LEDS];
+    pixel_map_stale = true;
+    coverage_stale = true;
+#ifdef PREMULTIPLIED_ALPHA
+    premul_leds = layer_slot ? layer_slot->premul_leds : new CPRGBA[MTX_NUM_LEDS];
+    premul_stale = true;
+    premul_brightness = 255;
+    leds_redrawn = true;
+    rendered_brightness = 255;
+#endif
 
     layer_type = static_cast<LayerType>(-1);
     id = -1;
@@ -103,6 +135,7 @@ ReAnimator::ReAnimator(uint8_t num_rows, uint8_t num_cols, uint8_t orientation)
     rgb = &internal_rgb;
     hue = HUE_YELLOW;
     proxy_color_set = false;
+    last_rgb = *rgb;
 
     _cb = noop_cb;
 
@@ -123,7 +156,7 @@ ReAnimator::ReAnimator(uint8_t num_rows, uint8_t num_cols, uint8_t orientation)
     pm_power_pellet_pos = 0;
     pm_power_pellet_flash_state = 1;
     //pm_puck_dots = (uint8_t*)malloc(MTX_NUM_LEDS*sizeof(uint8_t));
-    pm_puck_dots = new uint8_t[MTX_NUM_LEDS];
+    pm_puck_dots = layer_slot ? layer_slot->pm_puck_dots : new uint8_t[MTX_NUM_LEDS];
     for (uint16_t i = 0; i < MTX_NUM_LEDS; i++) {
       pm_puck_dots[i] = 0;
     }
@@ -154,6 +187,18 @@ ReAnimator::ReAnimator(uint8_t num_rows, uint8_t num_cols, uint8_t orientation)
     image_clean = false;
     image_queued_time = millis();
     display_duration = REFRESH_INTERVAL;
+    pristine_leds = nullptr;
+    images_in_flight = 0;
+    image_timing = {};
+    image_timing_pending = false;
+
+    seq_num_frames = 0;
+    seq_next_read = 0;
+    seq_next_frame = 0;
+    seq_shown = -1;
+    seq_deadline = millis();
+    seq_looped = false;
+    seq_first_pending = false;
 
 #if FONT_OPTION == 3
     if (MTX_NUM_ROWS <= 8) {
@@ -173,7 +218,6 @@ ReAnimator::ReAnimator(uint8_t num_rows, uint8_t num_cols, uint8_t orientation)
         font_scale = 2;
     }
 
-    glyph_draw_buf = nullptr;
     refresh_text_pos = 0;
     shift_char_column = 0;
     shift_char_tracking = 0; // spacing between letters
@@ -189,6 +233,11 @@ ReAnimator::ReAnimator(uint8_t num_rows, uint8_t num_cols, uint8_t orientation)
 
     iwopm = millis(); // previous millis for is_wait_over()
     fwpm = millis(); // previous millis for finished_waiting()
+    wake_time = millis();
+    wake_set = false;
+    wake_every_frame = false;
+
+    dirty = true;
 }
 
 
@@ -198,7 +247,90 @@ ReAnimator::Freezer::Freezer(ReAnimator &r) : parent(r) {
 }
 
 
+bool ReAnimator::reserve_layers(uint8_t count, uint8_t num_rows, uint8_t num_cols) {
+    if (layer_slots != nullptr || count == 0) {
+        return false;
+    }
+
+    const size_t align = alignof(std::max_align_t);
+    auto round_up = [align](size_t n) { return (n + align-1) & ~(align-1); };
+    uint16_t num_leds = num_rows*num_cols;
+    size_t slot_bytes = round_up(sizeof(ReAnimator)) + round_up(num_leds*sizeof(CRGBA)) + round_up(num_leds*sizeof(uint16_t)) + round_up(num_leds);
+#ifdef PREMULTIPLIED_ALPHA
+    slot_bytes += round_up(num_leds*sizeof(CPRGBA));
+#endif
+    // malloc() only promises 4 byte alignment on some chips, hence the extra align bytes
+    uint8_t* arena = (uint8_t*)malloc(round_up(count*sizeof(LayerSlot)) + count*slot_bytes + align);
+    if (arena == nullptr) {
+        return false;
+    }
+
+    uint8_t* p = (uint8_t*)round_up((uintptr_t)arena);
+    auto take = [&p, round_up](size_t n) { uint8_t* q = p; p += round_up(n); return q; };
+    layer_slots = (LayerSlot*)take(count*sizeof(LayerSlot));
+    for (uint8_t i = 0; i < count; i++) {
+        LayerSlot& slot = layer_slots[i];
+        slot.object = take(sizeof(ReAnimator));
+        slot.leds = (CRGBA*)take(num_leds*sizeof(CRGBA));
+        slot.pixel_map = (uint16_t*)take(num_leds*sizeof(uint16_t));
+        slot.pm_puck_dots = take(num_leds);
+#ifdef PREMULTIPLIED_ALPHA
+        slot.premul_leds = (CPRGBA*)take(num_leds*sizeof(CPRGBA));
+#endif
+        slot.in_use = false;
+        slot.images_in_flight = nullptr;
+        slot.released = 0;
+    }
+    num_layer_slots = count;
+    layer_slot_leds = num_leds;
+    return true;
+}
+
+
+void* ReAnimator::operator new(size_t size) {
+    LayerSlot* free_slot = nullptr;
+    if (size <= sizeof(ReAnimator)) {
+        for (uint8_t i = 0; i < num_layer_slots; i++) {
+            LayerSlot& slot = layer_slots[i];
+            bool loading = slot.images_in_flight != nullptr && *slot.images_in_flight > 0;
+            if (!slot.in_use && !loading && (free_slot == nullptr || slot.released < free_slot->released)) {
+                free_slot = &slot;
+            }
+        }
+    }
+    if (free_slot == nullptr) {
+        heap_layers++;
+        return ::operator new(size);
+    }
+    free_slot->in_use = true;
+    return free_slot->object;
+}
+
+
+void ReAnimator::operator delete(void* p) {
+    for (uint8_t i = 0; i < num_layer_slots; i++) {
+        if (layer_slots[i].object == p) {
+            layer_slots[i].in_use = false;
+            layer_slots[i].released = ++layer_slot_releases;
+            return;
+        }
+    }
+    ::operator delete(p);
+}
+
+
+void ReAnimator::layer_pool_stats(uint8_t& slots, uint8_t& in_use, uint32_t& on_heap) {
+    slots = num_layer_slots;
+    in_use = 0;
+    for (uint8_t i = 0; i < num_layer_slots; i++) {
+        in_use += layer_slots[i].in_use;
+    }
+    on_heap = heap_layers;
+}
+
+
 void ReAnimator::setup(LayerType layer_type_in, int8_t id_in) {
+    dirty = true;
     layer_brightness = 255;
     proxy_color_set = false;
 
@@ -230,6 +362,8 @@ void ReAnimator::setup(LayerType layer_type_in, int8_t id_in) {
         image_loaded = false;
         image_clean = false;
         image_queued_time = millis();
+        image_timing_pending = false;
+        end_sequence();
     }
 }
 
@@ -306,6 +440,7 @@ int8_t ReAnimator::set_pattern(Pattern pattern_in, bool reverse_in, bool disable
 
     int8_t retval = 0;
     is_xray = false;
+    dirty = true;
 
     if (autocycle_enabled && pattern_in == NO_PATTERN) {
         pattern_in = static_cast<Pattern>(pattern+1);
@@ -474,6 +609,7 @@ int8_t ReAnimator::set_accent(Accent accent_in, bool is_persistent) {
     else {
         transient_accent = accent_out;
     }
+    dirty = true;
 
     return retval;
 }
@@ -491,14 +627,116 @@ void ReAnimator::increment_accent(bool is_persistent) {
 
 void ReAnimator::set_image(String id, uint32_t duration, String* message) {
     image_path = form_path(F("im"), id, true);
+    image_queued_time = millis();
+    display_duration = duration;
+    end_sequence();
+    dirty = true;
+    request_image();
+}
+
+
+// copies the image from the cache if it is there, otherwise queues it for the loader task to read from flash
+void ReAnimator::request_image() {
+    image_timing = {};
+    image_timing.queued = micros();
+    image_timing_pending = true;
+    if (image_cache_get(image_path, leds, MTX_NUM_LEDS, &proxy_color_set, &proxy_color)) {
+        image_timing.cached = true;
+        image_timing.decoded = micros();
+        image_loaded = true;
+        image_clean = true;
+        image_dequeued = true;
+        return;
+    }
     image_dequeued = false;
     image_loaded = false;
     image_clean = false;
-    image_queued_time = millis();
-    display_duration = duration;
     //xQueueSend makes a copy of image, so it is OK that image is a local variable.
-    Image image = {&image_path, &MTX_NUM_LEDS, leds, &proxy_color_set, &proxy_color, &image_dequeued, &image_loaded, &image_clean};
-    xQueueSend(qimages, (void *)&image, 0);
+    Image image = {&image_path, &MTX_NUM_LEDS, leds, &proxy_color_set, &proxy_color, &image_dequeued, &image_loaded, &image_clean, -1, nullptr, &image_timing, true, nullptr, &images_in_flight};
+    images_in_flight++;
+    if (image_batch.open && image_batch.count < NUM_LAYERS) {
+        image_batch.images[image_batch.count++] = image;
+        return;
+    }
+    pending_images++;
+    if (xQueueSend(qimages, (void *)&image, 0) != pdTRUE) {
+        pending_images--;
+        images_in_flight--;
+    }
+}
+
+
+void ReAnimator::begin_image_batch() {
+    if (image_batch.dequeued) {
+        image_batch.count = 0;
+        image_batch.open = true;
+    }
+}
+
+
+void ReAnimator::end_image_batch() {
+    if (!image_batch.open) {
+        return;
+    }
+    image_batch.open = false;
+    if (image_batch.count == 0) {
+        return;
+    }
+
+    image_batch.dequeued = false;
+    pending_images += image_batch.count;
+    Image request = {};
+    request.batch = &image_batch;
+    if (xQueueSend(qimages, (void *)&request, 0) != pdTRUE) {
+        pending_images -= image_batch.count;
+        image_batch.dequeued = true;
+        // one at a time is better than not at all
+        for (uint8_t i = 0; i < image_batch.count; i++) {
+            pending_images++;
+            if (xQueueSend(qimages, (void *)&image_batch.images[i], 0) != pdTRUE) {
+                pending_images--;
+                (*image_batch.images[i].in_flight)--;
+            }
+        }
+    }
+}
+
+
+bool ReAnimator::images_pending() {
+    return pending_images > 0;
+}
+
+
+bool ReAnimator::prefetch_image(String id, uint16_t num_leds) {
+    String path = form_path(F("im"), id, true);
+    if (image_cache_contains(path, num_leds)) {
+        return true;
+    }
+
+    PrefetchSlot& slot = prefetch_slot;
+    if (!slot.image_dequeued) {
+        return false;
+    }
+    if (slot.num_leds != num_leds) {
+        free(slot.leds);
+        slot.leds = (CRGBA*)malloc(num_leds*sizeof(CRGBA));
+        slot.num_leds = (slot.leds != nullptr) ? num_leds : 0;
+    }
+    if (slot.leds == nullptr) {
+        return false;
+    }
+
+    // load_image() puts whatever it decodes into the cache, so the slot is only scratch space
+    slot.image_path = path;
+    slot.image_dequeued = false;
+    slot.image_loaded = false;
+    slot.image_clean = false;
+    Image image = {&slot.image_path, &slot.num_leds, slot.leds, &slot.proxy_color_set, &slot.proxy_color, &slot.image_dequeued, &slot.image_loaded, &slot.image_clean, -1, nullptr, nullptr, false, nullptr, nullptr};
+    if (xQueueSend(qimages, (void *)&image, 0) != pdTRUE) {
+        slot.image_dequeued = true;
+        return false;
+    }
+    return true;
 }
 
 
@@ -506,72 +744,134 @@ void ReAnimator::set_image(String id, uint32_t duration, String* message) {
 // loading an image takes a while which can make the animation laggy if ran on the same core as the main code
 void ReAnimator::load_image_from_queue(void* parameter) {
     for (;;) {
-        // calling vTaskDelay() prevents watchdog error, but I'm not sure why and if this is a good way to handle it  
-        vTaskDelay(pdMS_TO_TICKS(1)); // 1 ms
         Image image;
-        if (xQueueReceive(qimages, (void *)&image, 0) == pdTRUE) {
+        // blocks until an image is queued, so the task does not run at all while there is nothing to load
+        if (xQueueReceive(qimages, (void *)&image, portMAX_DELAY) == pdTRUE) {
+            //print_dt();
+            if (image.batch != nullptr) {
+                ImageBatch& batch = *image.batch;
+                uint16_t max_leds = 0;
+                for (uint8_t i = 0; i < batch.count; i++) {
+                    max_leds = max(max_leds, *(batch.images[i].MTX_NUM_LEDS));
+                }
+                // every binary image in the batch is read into the same buffer
+                uint8_t* read_buffer = (uint8_t*)malloc(max_leds*sizeof(CRGBA));
+                for (uint8_t i = 0; i < batch.count; i++) {
+                    load_image(batch.images[i], read_buffer);
+                }
+                free(read_buffer);
+                batch.dequeued = true;
+            }
+            else {
+                load_image(image);
+            }
+            // wake the render loop so it shows the image right away instead of finding out on its next pass
+            if (image_notify_task != nullptr) {
+                xTaskNotifyGive(image_notify_task);
+            }
             //print_dt();
+        }
+    }
+    vTaskDelete(NULL);
+}
 
-            // cannot set image_dequeued here because it may be read before a proper value for image_loaded is determined
-            //*(image.image_dequeued) = true;
 
-            // make sure we are not referencing leds in a layer that was destroyed
-            if (image.leds == nullptr) {
-                *(image.image_loaded) = false;
-                *(image.image_clean) = false;
-                *(image.image_dequeued) = true;
-                continue;
-            }
+void ReAnimator::notify_on_image_load(TaskHandle_t task) {
+    image_notify_task = task;
+}
 
-            if (*(image.image_path) == "") {
-                *(image.image_loaded) = false;
-                *(image.image_clean) = false;
-                *(image.image_dequeued) = true;
-                continue;
-            }
 
-            File file = LittleFS.open(*(image.image_path), "r");
-            if (!file) {
-                *(image.image_loaded) = false;
-                *(image.image_clean) = false;
-                *(image.image_dequeued) = true;
-                continue;
-            }
+void ReAnimator::load_image(Image& image, uint8_t* read_buffer) {
+    // cannot set image_dequeued here because it may be read before a proper value for image_loaded is determined
+    //*(image.image_dequeued) = true;
 
-            if (file.available()) {
-                DynamicJsonDocument doc(8192);
-                ReadBufferingStream bufferedFile(file, 64);
-                DeserializationError error = deserializeJson(doc, bufferedFile);
-                if (error) {
-                    *(image.image_loaded) = false;
-                    *(image.image_clean) = false;
-                    *(image.image_dequeued) = true;
-                    continue;
-                }
+    ImageTiming scratch;
+    ImageTiming* timing = (image.timing != nullptr) ? image.timing : &scratch;
+    timing->dequeued = micros();
 
-                JsonObject object = doc.as<JsonObject>();
+    // make sure we are not referencing leds in a layer that was destroyed
+    if (image.leds == nullptr) {
+        *(image.image_loaded) = false;
+        *(image.image_clean) = false;
+        image_done(image);
+        return;
+    }
 
-                *(image.proxy_color_set) = false;
-                if (!object[F("pc")].isNull()) {
-                    std::string pc = object[F("pc")].as<std::string>();
-                    if (!pc.empty()) {
-                        *(image.proxy_color) = std::stoul(pc, nullptr, 16);
-                        *(image.proxy_color_set) = true;
-                    }
-                }
+    if (*(image.image_path) == "") {
+        *(image.image_loaded) = false;
+        *(image.image_clean) = false;
+        image_done(image);
+        return;
+    }
 
-                // for unknown reasons initializing the leds[] to all black
-                // makes the code slightly faster
-                for (uint16_t i = 0; i < *(image.MTX_NUM_LEDS); i++) image.leds[i] = CRGBA::Transparent;
-                *(image.image_loaded) = deserializeSegment(object, image.leds, *(image.MTX_NUM_LEDS));
-                *(image.image_clean) = *(image.image_loaded);
-                *(image.image_dequeued) = true;
-            }
-            file.close();
-            //print_dt();
+    if (image.frame >= 0) {
+        // a sequence goes through all of its frames before it shows one again, so they would only push images out of the image cache
+        *(image.image_loaded) = read_sequence_frame(*(image.image_path), image.frame, image.leds, *(image.MTX_NUM_LEDS), image.proxy_color_set, image.proxy_color, image.duration);
+        *(image.image_clean) = *(image.image_loaded);
+        image_done(image);
+        return;
+    }
+
+    // the binary copy of the image loads with a single read. if there is none yet, or it is stale, decode the JSON
+    // and save a binary copy for next time.
+    String bin_path = image_bin_path(*(image.image_path));
+    if (read_image_bin(bin_path, image.leds, *(image.MTX_NUM_LEDS), image.proxy_color_set, image.proxy_color, timing, read_buffer)) {
+        image_cache_put(*(image.image_path), image.leds, *(image.MTX_NUM_LEDS), *(image.proxy_color_set), *(image.proxy_color));
+        *(image.image_loaded) = true;
+        *(image.image_clean) = true;
+        image_done(image);
+        return;
+    }
+
+    File file = LittleFS.open(*(image.image_path), "r");
+    if (!file) {
+        *(image.image_loaded) = false;
+        *(image.image_clean) = false;
+        image_done(image);
+        return;
+    }
+    timing->opened = micros();
+
+    *(image.image_loaded) = false;
+    if (file.available()) {
+        ReadBufferingStream bufferedFile(file, 64);
+        *(image.image_loaded) = decode_image_json(bufferedFile, image.leds, *(image.MTX_NUM_LEDS), image.proxy_color_set, image.proxy_color);
+        timing->parsed = micros();
+        timing->decoded = timing->parsed;
+        if (*(image.image_loaded)) {
+            write_image_bin(bin_path, image.leds, *(image.MTX_NUM_LEDS), *(image.proxy_color_set), *(image.proxy_color));
+            image_cache_put(*(image.image_path), image.leds, *(image.MTX_NUM_LEDS), *(image.proxy_color_set), *(image.proxy_color));
+        }
+    }
+    // an empty file is a broken image, which has to be reported too or the layer would wait on it forever
+    *(image.image_clean) = *(image.image_loaded);
+    image_done(image);
+    file.close();
+}
+
+
+// the last thing the loader task does with an image. it is counted out of pending_images first, so anything that
+// sees the image dequeued also sees it gone from images_pending(). in_flight goes last, since once it is 0 the layer's
+// slot can be given to a new layer.
+void ReAnimator::image_done(Image& image) {
+    if (image.counted) {
+        pending_images--;
+    }
+    *(image.image_dequeued) = true;
+    if (image.in_flight) {
+        (*image.in_flight)--;
+    }
+}
+
+
+void ReAnimator::report_image_shown() {
+    if (image_timing_pending && image_dequeued) {
+        image_timing_pending = false;
+        // a broken image was never shown
+        if (image_loaded) {
+            image_stats_add(image_timing, micros());
         }
     }
-    vTaskDelete(NULL);
 }
 
 
@@ -588,12 +888,191 @@ int8_t ReAnimator::get_image_status() {
 }
 
 
+void ReAnimator::set_sequence(String fs_path, uint16_t num_frames) {
+    for (uint8_t i = 0; i < SEQUENCE_BUFFER_FRAMES; i++) {
+        // a frame of the last sequence may still be loading. its slot is free again once the loader task is done with it.
+        seq_slots[i].frame = -1;
+    }
+
+    image_path = fs_path;
+    image_queued_time = millis();
+    if (!seq_first_pending) {
+        seq_first_pending = true;
+        pending_images++;
+    }
+    seq_num_frames = num_frames;
+    seq_next_read = 0;
+    seq_next_frame = 0;
+    seq_shown = -1;
+    seq_looped = false;
+    // like an image, the layer is not shown until its first frame is in leds[]
+    image_timing_pending = false;
+    image_dequeued = false;
+    image_loaded = false;
+    image_clean = false;
+    dirty = true;
+    queue_sequence_frames();
+}
+
+
+void ReAnimator::end_sequence() {
+    seq_num_frames = 0;
+    if (seq_first_pending) {
+        seq_first_pending = false;
+        pending_images--;
+    }
+}
+
+
+bool ReAnimator::is_sequence() {
+    return layer_type == Image_t && seq_num_frames > 0;
+}
+
+
+bool ReAnimator::sequence_looped() {
+    bool looped = seq_looped;
+    seq_looped = false;
+    return looped;
+}
+
+
+bool ReAnimator::sequence_frame_pending() {
+    if (!is_sequence() || (seq_shown >= 0 && (int32_t)(millis() - seq_deadline) < 0)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < SEQUENCE_BUFFER_FRAMES; i++) {
+        if (i != seq_shown && seq_slots[i].frame == seq_next_frame && seq_slots[i].image_dequeued) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// queues the frames after the one being shown into every free slot, in order, so the loader task reads them in the order they are shown
+void ReAnimator::queue_sequence_frames() {
+    for (uint8_t i = 0; i < SEQUENCE_BUFFER_FRAMES; i++) {
+        SequenceSlot& slot = seq_slots[i];
+        if (slot.frame >= 0 || !slot.image_dequeued) {
+            continue;
+        }
+        if (slot.num_leds != MTX_NUM_LEDS) {
+            free(slot.leds);
+            slot.leds = (CRGBA*)malloc(MTX_NUM_LEDS*sizeof(CRGBA));
+            slot.num_leds = (slot.leds != nullptr) ? MTX_NUM_LEDS : 0;
+        }
+        if (slot.leds == nullptr) {
+            return;
+        }
+        slot.image_path = image_path;
+        slot.frame = seq_next_read;
+        slot.image_dequeued = false;
+        slot.image_loaded = false;
+        slot.image_clean = false;
+        Image image = {&slot.image_path, &slot.num_leds, slot.leds, &slot.proxy_color_set, &slot.proxy_color, &slot.image_dequeued, &slot.image_loaded, &slot.image_clean, slot.frame, &slot.duration, nullptr, false, nullptr, nullptr};
+        if (xQueueSend(qimages, (void *)&image, 0) != pdTRUE) {
+            // the queue is full. refresh_sequence() tries again on its next call.
+            slot.frame = -1;
+            slot.image_dequeued = true;
+            return;
+        }
+        seq_next_read = (seq_next_read+1) % seq_num_frames;
+    }
+}
+
+
+void ReAnimator::refresh_sequence() {
+    if (seq_shown >= 0 && (int32_t)(millis() - seq_deadline) < 0) {
+        if (!image_clean) {
+            // frozen_decay changed the frame, so copy it again from its slot
+            memcpy((void*)leds, (void*)seq_slots[seq_shown].leds, MTX_NUM_LEDS*sizeof(CRGBA));
+            image_clean = true;
+            dirty = true;
+        }
+        queue_sequence_frames();
+        wake_by(seq_deadline);
+        return;
+    }
+
+    // a broken frame is skipped. only a ring's worth are skipped per call so a sequence with nothing but broken frames cannot hang the render loop.
+    for (uint8_t tries = 0; tries < SEQUENCE_BUFFER_FRAMES; tries++) {
+        int8_t next = -1;
+        for (uint8_t i = 0; i < SEQUENCE_BUFFER_FRAMES; i++) {
+            if (i != seq_shown && seq_slots[i].frame == seq_next_frame && seq_slots[i].image_dequeued) {
+                next = i;
+                break;
+            }
+        }
+        if (next < 0) {
+            // the loader task is still reading the frame. it wakes the render loop when it is done, see notify_on_image_load().
+            queue_sequence_frames();
+            wake_every_frame = true;
+            return;
+        }
+
+        SequenceSlot& slot = seq_slots[next];
+        if (seq_next_frame == seq_num_frames-1) {
+            seq_looped = true;
+        }
+        seq_next_frame = (seq_next_frame+1) % seq_num_frames;
+
+        if (!slot.image_loaded) {
+            slot.frame = -1;
+            if (seq_shown < 0) {
+                // report the broken frame so show() does not wait on the layer forever
+                image_dequeued = true;
+                if (seq_first_pending) {
+                    seq_first_pending = false;
+                    pending_images--;
+                }
+            }
+            queue_sequence_frames();
+            continue;
+        }
+
+        memcpy((void*)leds, (void*)slot.leds, MTX_NUM_LEDS*sizeof(CRGBA));
+        proxy_color_set = slot.proxy_color_set;
+        proxy_color = slot.proxy_color;
+
+        // each deadline follows on from the last one so lateness in showing one frame does not push back every frame after it.
+        // the layer starts over from now if it fell a whole frame behind, e.g. while it was frozen, instead of racing to catch up.
+        uint32_t duration = max(slot.duration, (uint32_t)1);
+        // show() paces the refreshes by display_duration (see composite()), so it has to follow each frame's own duration
+        display_duration = duration;
+        if (seq_shown < 0 || (int32_t)(millis() - (seq_deadline+duration)) >= 0) {
+            seq_deadline = millis() + duration;
+        }
+        else {
+            seq_deadline += duration;
+        }
+
+        if (seq_shown >= 0) {
+            seq_slots[seq_shown].frame = -1;
+        }
+        seq_shown = next;
+        if (seq_first_pending) {
+            seq_first_pending = false;
+            pending_images--;
+        }
+        image_dequeued = true;
+        image_loaded = true;
+        image_clean = true;
+        dirty = true;
+        queue_sequence_frames();
+        wake_by(seq_deadline);
+        return;
+    }
+    wake_every_frame = true;
+}
+
+
 void ReAnimator::set_text(std::string t) {
     // need to reinitialize when one string was already being written and new string is set
     refresh_text_pos = 0; // start at the beginning of a string
     shift_char_column = 0; // start at the beginning of a glyph
 
     ftext.s = t;
+    dirty = true;
     ftext.line_height = 0;
     ftext.base_line = 0;
     ftext.vmargin = 0;
@@ -627,6 +1106,7 @@ void ReAnimator::set_text(std::string t) {
 
 void ReAnimator::set_info(Info type) {
   id = type;
+  dirty = true;
   //switch(type) {
   //  default:
   //    // fall through to next case
@@ -653,6 +1133,8 @@ void ReAnimator::set_info(Info type) {
 // if internal_rgb is used then rgb is made to point to that.
 void ReAnimator::set_color(CRGB *color) {
   rgb = color;
+  last_rgb = *rgb;
+  dirty = true;
   CHSV chsv = rgb2hsv_approximate(*color);
   // if color is 0x000000 (black) then hue will be 0 which is red when CHSV(hue, 255, 255)
   // for the patterns that use hue it does not make sense for them to use black anyway
@@ -676,6 +1158,8 @@ void ReAnimator::set_heading(uint8_t h) {
     // this allows for one image to be swapped in for another while maintaining the same position and path.
     t_initial = (heading != h);
     heading = h;
+    pixel_map_stale = true;
+    dirty = true;
 }
 
 
@@ -683,16 +1167,29 @@ void ReAnimator::clear() {
     for (uint16_t i = 0; i < MTX_NUM_LEDS; i++) {
         leds[i] = CRGBA::Transparent;
     }
+    dirty = true;
 }
 
 
-void ReAnimator::reanimate() {
+bool ReAnimator::reanimate() {
+    wake_set = false;
+    wake_every_frame = false;
+
     // some patterns rely on hue. if rgb is dynamic, it is ever changing, so hue has to be updated to reflect the current rgb value.
     CHSV chsv = rgb2hsv_approximate(*rgb);
     // if color is 0x000000 (black) then hue will be 0 which is red when CHSV(hue, 255, 255)
     // for the patterns that use hue it does not make sense for them to use black anyway
     hue = chsv.h;
 
+    // most effects bake *rgb into leds[] when they draw, which marks the layer dirty anyway.
+    // images with a proxy color are the exception. render_span() reads *rgb, so a new dynamic color changes the image right away.
+    if (*rgb != last_rgb) {
+        last_rgb = *rgb;
+        if (layer_type == Image_t && proxy_color_set) {
+            dirty = true;
+        }
+    }
+
     if (autocycle_enabled) {
         autocycle();
     }
@@ -702,13 +1199,19 @@ void ReAnimator::reanimate() {
     }
 
     if (!freezer.is_frozen()) {
-        if (layer_type == Image_t && image_loaded && !image_clean) {
+        if (is_sequence()) {
+            refresh_sequence();
+        }
+        else if (layer_type == Image_t && image_loaded && !image_clean) {
             // frozen_decay changed image, so refresh the image.
-            image_dequeued = false;
-            image_loaded = false;
-            image_clean = false;
-            Image image = {&image_path, &MTX_NUM_LEDS, leds, &proxy_color_set, &proxy_color, &image_dequeued, &image_loaded, &image_clean};
-            xQueueSend(qimages, (void *)&image, 0);
+            dirty = true;
+            if (pristine_leds != nullptr) {
+                memcpy((void*)leds, (void*)pristine_leds, MTX_NUM_LEDS*sizeof(CRGBA));
+                image_clean = true;
+            }
+            else {
+                request_image();
+            }
         }
         else if (layer_type == Pattern_t) {
             run_pattern(pattern);
@@ -725,54 +1228,270 @@ void ReAnimator::reanimate() {
     apply_accent(transient_accent);
     apply_accent(persistent_accent);
 
+    if (layer_type == Image_t && !image_dequeued) {
+        // the loader task is still writing leds[]. it wakes the render loop when it is done, see notify_on_image_load().
+        dirty = true;
+    }
+
+    if ((layer_type == Image_t && proxy_color_set) || heading != 0) {
+        // a dynamic proxy color changes every frame and nothing here can tell whether *rgb is dynamic.
+        // a moving layer moves every frame.
+        wake_every_frame = true;
+    }
+
+    if (!wake_set) {
+        // nothing is waiting on a timer, so only a setter can change the layer. look again now and then anyway.
+        wake_by(millis()+1000);
+    }
+
     //print_dt();
+
+    if (dirty) {
+        mark_leds_changed();
+    }
+
+    // a moving layer shifts one step every time render_span() sweeps leds[], so it changes every frame
+    // even though leds[] may not have.
+    bool changed = dirty || heading != 0;
+    dirty = false;
+    return changed;
 }
 
 
-CRGBA ReAnimator::get_pixel(uint16_t i) {
-    //CRGBA pixel_out = 0xFF000000; // if black with no transparency is used it creates a sort of spotlight effect
-    CRGBA pixel_out = CRGBA::Transparent;
+uint32_t ReAnimator::get_deadline() {
+    return wake_time;
+}
 
-    if (MTX_ORIENTATION == 1) {
-        // rotated 90 degrees counterclockwise
-        Point p;
-        Point q;
-        p = serp2cart_native(i);
-        q.x = MTX_NUM_COLS-1 - p.y;
-        q.y = p.x;
-        i = cart2serp(q);
+
+bool ReAnimator::is_due() {
+    // dirty outside of reanimate() means a setter changed the layer, so it has to be reanimated right away
+    return dirty || wake_every_frame || (int32_t)(millis() - wake_time) >= 0;
+}
+
+
+// one pass over n pixels starting at LED start. every test that is the same for the whole layer is made
+// once in render_span() and baked into the kernel, so the loop for each kind of layer has no per pixel branching on it.
+template <BlendKernel kernel>
+void ReAnimator::blend_span(CRGB* dst, uint16_t start, uint16_t n, uint8_t brightness, uint8_t alpha_scaling_factor) {
+    const CRGB proxy = proxy_color;
+    const CRGB substitute_rgb = *rgb;
+
+    for (uint16_t i = start; i < start+n; i++) {
+        uint16_t ti = pixel_map[i];
+
+        if (kernel == OPAQUE_COPY) {
+            // every LED shows a fully opaque pixel, so it replaces whatever is underneath
+            CRGB pixel = (CRGB)leds[ti];
+            nscale8x3(pixel.r, pixel.g, pixel.b, brightness);
+            dst[i] = pixel;
+            continue;
+        }
+
+#ifdef PREMULTIPLIED_ALPHA
+        if (kernel == PREMULTIPLIED_COPY) {
+            dst[i] = (CRGB)premul_leds[ti];
+            continue;
+        }
+
+        if (kernel == PREMULTIPLIED_BLEND) {
+            if (ti < MTX_NUM_LEDS) {
+                nblend_premultiplied(dst[i], premul_leds[ti]);
+            }
+            continue;
+        }
+#endif
+
+        //CRGBA pixel = 0xFF000000; // if black with no transparency is used it creates a sort of spotlight effect
+        CRGBA pixel = CRGBA::Transparent;
+        if (ti < MTX_NUM_LEDS) {
+            pixel = leds[ti];
+
+            // color substitution
+            // some browsers slightly modify the RGB values of the canvas to prevent tracking. Brave calls this farbling.
+            // this means the values sent from the converter page do not have the exact same RGB values as the source image.
+            // this if condition accepts values that are similar to the proxy_color.
+            //if ( (abs(pixel.r - proxy.r) + abs(pixel.g - proxy.g) + abs(pixel.b - proxy.b) < 7) ) {
+            // a workaround was found for the converter page code such that the data does not get farbled, but keeping the above
+            // if statement in case it is useful in the future.
+            if (kernel == PROXY_BLEND && pixel == proxy) {
+                uint8_t alpha = pixel.a;
+                pixel = substitute_rgb;
+                pixel.a = alpha;
+            }
+
+            nscale8x3(pixel.r, pixel.g, pixel.b, brightness);
+            pixel.a = scale8(pixel.a, alpha_scaling_factor);
+        }
+
+        CRGB bgpixel = dst[i];
+        if (kernel == XRAY_BLEND) {
+            // most effects have active pixels that are colored and are opaque or semitransparent.
+            // the active pixels are surrounded by negative space which is fully transparent black.
+            // this allows layers to be drawn on top of each other to combine effects.
+            // for xray patterns we want an opaque negative space which hides what is underneath and
+            // active pixels that reveal what is underneath.
+            // xray patterns are created the same as regular patterns (i.e. transparent negative space)
+            // and then converted to have an opaque negative space and active pixels that are effectively
+            // transparent in this block.
+
+            uint8_t gray_value = (bgpixel.r + bgpixel.g + bgpixel.b) / 3;
+
+            bool is_colored = ((CRGB)pixel != (CRGB)0);
+            if (is_colored) {
+                // use the gray scale value of the pixel below to adjust the pattern's color such that the effect
+                // from the layer below is shown in a new color for the composite
+                nscale8x3(pixel.r, pixel.g, pixel.b, gray_value);
+                // data for bgpixel has been transferred to pixel, so set it to black so nblend() produces the correct output
+                bgpixel = CRGB::Black;
+            }
+            else {
+                // else pixel is fully transparent black or semitransparent black.
+                // if it is fully transparent, then it is negative space, so hide everything beneath by setting alpha to 255 (fully opaque).
+                // if it is opaque black or semi transparent black, then it is an active pixel, so invert its transparency so the pixels
+                // underneath can be seen as is.
+
+                // flipping the opaqueness has the effect of only showing the layer underneath
+                // when the pixels of the layer above are not completely transparent.
+                // that is completely transparent areas become completely opaque and hide what is underneath.
+                pixel.a = 255 - pixel.a;
+            }
+        }
+        dst[i] = nblend(bgpixel, (CRGB)pixel, pixel.a);
+    }
+}
+
+
+// blends count pixels of this layer, starting at LED start, with the combination of the previous layers already in dst[].
+// dst[] is indexed by LED, so dst[start] is the first pixel written. flatten.
+void ReAnimator::render_span(CRGB* dst, uint16_t start, uint16_t count) {
+    // because setBrightness() will effect the brightness of every led in every layer nscale8x3 is used instead.
+    // setBrightness() should only be used in the main code
+    const uint8_t brightness = layer_brightness;
+    // as layer_brightness level gets dimmer lower the alpha/increase the transparency
+    const uint8_t alpha_scaling_factor = (layer_brightness < 64) ? 4*layer_brightness : 255;
+
+    // xray patterns are never images, so they never need color substitution.
+    // is_opaque() is only true for a stationary layer, so every LED has a pixel.
+    BlendKernel kernel = NORMAL_BLEND;
+    if (is_xray) {
+        kernel = XRAY_BLEND;
+    }
+#ifdef PREMULTIPLIED_ALPHA
+    // building premul_leds[] costs about as much as a blend, so it only pays off for a layer that is blended again
+    // without changing, e.g. an image under an animated pattern. a layer that is drawn on or dimmed every frame keeps blending leds[].
+    // the proxy color is substituted when premul_leds[] is built, so images do not need a kernel of their own.
+    else if (!((premul_stale || premul_brightness != brightness) && (leds_redrawn || rendered_brightness != brightness))) {
+        kernel = is_opaque() ? PREMULTIPLIED_COPY : PREMULTIPLIED_BLEND;
+        if (premul_stale || premul_brightness != brightness) {
+            build_premultiplied(alpha_scaling_factor);
+        }
+    }
+#endif
+    else if (layer_type == Image_t && proxy_color_set) {
+        kernel = PROXY_BLEND;
     }
+    else if (is_opaque()) {
+        kernel = OPAQUE_COPY;
+    }
+#ifdef PREMULTIPLIED_ALPHA
+    leds_redrawn = false;
+    rendered_brightness = brightness;
+#endif
 
-    uint16_t ti = mover(i);
-    if (0 <= ti && ti < MTX_NUM_LEDS) {
-        pixel_out = leds[ti];
+    while (count > 0) {
+        if (pixel_map_stale) {
+            build_pixel_map();
+        }
 
-        // color substitution
-        // some browsers slightly modify the RGB values of the canvas to prevent tracking. Brave calls this farbling.
-        // this means the values sent from the converter page do not have the exact same RGB values as the source image.
-        // this if condition accepts values that are similar to the proxy_color.
-        //if ( layer_type == Image_t && proxy_color_set && (abs(pixel_out.r - proxy_color.r) + abs(pixel_out.g - proxy_color.g) + abs(pixel_out.b - proxy_color.b) < 7) ) {
-        // a workaround was found for the converter page code such that the data does not get farbled, but keeping the above
-        // if statement in case it is useful in the future.
+        // a moving layer steps once every pixel has been blended once. a span that runs past the end of a sweep
+        // is split there so the rest of it is drawn at the new position.
+        uint16_t n = count;
+        if (heading != 0) {
+            n = min(n, (uint16_t)(MTX_NUM_LEDS - t_pixel_count));
+        }
 
-        if ( layer_type == Image_t && proxy_color_set && pixel_out == proxy_color ) {
-            pixel_out = *rgb;
-            pixel_out.a = leds[ti].alpha;
+        switch (kernel) {
+            case NORMAL_BLEND:
+                blend_span<NORMAL_BLEND>(dst, start, n, brightness, alpha_scaling_factor);
+                break;
+            case XRAY_BLEND:
+                blend_span<XRAY_BLEND>(dst, start, n, brightness, alpha_scaling_factor);
+                break;
+            case PROXY_BLEND:
+                blend_span<PROXY_BLEND>(dst, start, n, brightness, alpha_scaling_factor);
+                break;
+            case OPAQUE_COPY:
+                blend_span<OPAQUE_COPY>(dst, start, n, brightness, alpha_scaling_factor);
+                break;
+#ifdef PREMULTIPLIED_ALPHA
+            case PREMULTIPLIED_BLEND:
+                blend_span<PREMULTIPLIED_BLEND>(dst, start, n, brightness, alpha_scaling_factor);
+                break;
+            case PREMULTIPLIED_COPY:
+                blend_span<PREMULTIPLIED_COPY>(dst, start, n, brightness, alpha_scaling_factor);
+                break;
+#endif
+            default:
+                break;
+        }
+
+        if (heading != 0) {
+            t_pixel_count += n;
+            if (t_pixel_count == MTX_NUM_LEDS) {
+                t_pixel_count = 0;
+                mover_step();
+            }
         }
 
-        // because setBrightness() will effect the brightness of every led in every layer nscale8x3 is used instead.
-        // setBrightness() should only be used in the main code
-        nscale8x3(pixel_out.r, pixel_out.g, pixel_out.b, layer_brightness);
+        start += n;
+        count -= n;
+    }
+}
+
+
+// a layer that is not blended because it is hidden or fully transparent still has to keep moving,
+// so step it along as if count pixels had been blended.
+void ReAnimator::skip_span(uint16_t count) {
+    while (heading != 0 && count > 0) {
+        if (pixel_map_stale) {
+            build_pixel_map();
+        }
 
-        // as layer_brightness level gets dimmer lower the alpha/increase the transparency
-        uint8_t alpha_scaling_factor = 255;
-        if (layer_brightness < 64) {
-            alpha_scaling_factor = 4*layer_brightness;
+        uint16_t n = min(count, (uint16_t)(MTX_NUM_LEDS - t_pixel_count));
+        t_pixel_count += n;
+        if (t_pixel_count == MTX_NUM_LEDS) {
+            t_pixel_count = 0;
+            mover_step();
         }
-        pixel_out.a = scale8(pixel_out.a, alpha_scaling_factor);
+        count -= n;
     }
+}
+
 
-    return pixel_out;
+// true if blending the layer would not change anything underneath it.
+bool ReAnimator::is_transparent() {
+    if (is_xray) {
+        // the negative space of an xray pattern is opaque
+        return false;
+    }
+    if (layer_brightness == 0) {
+        // alpha_scaling_factor is 0 in render_span()
+        return true;
+    }
+    update_coverage();
+    return (num_transparent == MTX_NUM_LEDS);
+}
+
+
+// true if blending the layer would completely hide everything underneath it.
+bool ReAnimator::is_opaque() {
+    // xray layers use the pixel underneath, dim layers are made partly transparent,
+    // and a moving layer leaves gaps where it has not entered yet or has wrapped around.
+    if (is_xray || layer_brightness < 64 || heading != 0) {
+        return false;
+    }
+    update_coverage();
+    return (num_opaque == MTX_NUM_LEDS);
 }
 
 
@@ -895,8 +1614,18 @@ int8_t ReAnimator::apply_accent(Accent accent) {
         case FROZEN_DECAY:
             freezer.timer(7000);
             if (freezer.is_frozen()) {
+                if (layer_type == Image_t && !is_sequence() && image_dequeued && image_loaded && image_clean) {
+                    // leds[] still holds the image as loaded, so keep it for when the layer thaws
+                    if (pristine_leds == nullptr) {
+                        pristine_leds = new CRGBA[MTX_NUM_LEDS];
+                    }
+                    memcpy((void*)pristine_leds, (void*)leds, MTX_NUM_LEDS*sizeof(CRGBA));
+                }
                 vanish_randomly(7, 130);
                 image_clean = false;
+                dirty = true;
+                // the decay advances a step per call
+                wake_by(millis()+1);
             }
             break;
     }
@@ -1109,6 +1838,9 @@ void ReAnimator::solid(uint16_t draw_interval) {
 
 // inspired by juggle from FastLED/examples/DemoReel00.ino -Mark Kriegsman, December 2014
 void ReAnimator::pendulum() {
+    dirty = true; // redraws on every call
+    // these advance a step per call instead of with millis(), so keep calling them as often as possible
+    wake_by(millis()+1);
     const uint8_t bpm_offset = 56;
     const uint8_t num_columns = MTX_NUM_COLS;
     fadeToTransparentBy(leds, MTX_NUM_LEDS, 15);
@@ -1132,6 +1864,9 @@ void ReAnimator::pendulum() {
 
 
 void ReAnimator::funky() {
+    dirty = true; // redraws on every call
+    // these advance a step per call instead of with millis(), so keep calling them as often as possible
+    wake_by(millis()+1);
     const uint8_t bpm_offset = 14;
     const uint8_t num_columns = MTX_NUM_COLS;
     byte ball_hue = hue;
@@ -1153,6 +1888,9 @@ void ReAnimator::funky() {
 
 
 void ReAnimator::riffle() {
+    dirty = true; // redraws on every call
+    // these advance a step per call instead of with millis(), so keep calling them as often as possible
+    wake_by(millis()+1);
     uint8_t ball_hue = hue;
     uint8_t i = 0;
     //fadeToTransparentBy(leds, MTX_NUM_LEDS, 5); // takes longer for colors to separate and appear distinct if this is used for this pattern
@@ -1405,7 +2143,7 @@ void ReAnimator::breathing(uint16_t interval) {
         // up time so the breathing pattern looks more like a triangle waves with the upper peaks chopped off.
         // that is the brightness plateaus and stays stuck at the same level for a while instead of always changing
         //
-        // however since layer_brightness is used in nscale8() (see get_pixel()) and not FastLED.setBrightness() and
+        // however since layer_brightness is used in nscale8() (see render_span()) and not FastLED.setBrightness() and
         // FastLED.setBrightness(homogenized_brightness) is called after the layers are combined, the breathing layer
         // ends up appearing too dim. for this code, setting max_brightness to 255 does not result in the breathing
         // effect plateauing at homogenized_brightness
@@ -1464,6 +2202,13 @@ bool ReAnimator::load_image_from_file(String fs_path, String* message) {
     if (fs_path == "") {
       return false;
     }
+    if (read_image_bin(image_bin_path(fs_path), leds, MTX_NUM_LEDS, &proxy_color_set, &proxy_color)) {
+        dirty = true;
+        if (message) {
+            *message = F("set_image(): Matrix loaded.");
+        }
+        return true;
+    }
     File file = LittleFS.open(fs_path, "r");
 
     if(!file){
@@ -1473,32 +2218,16 @@ bool ReAnimator::load_image_from_file(String fs_path, String* message) {
         return false;
     }
     if (file.available()) {
-        DynamicJsonDocument doc(8192);
         ReadBufferingStream bufferedFile(file, 64);
-        DeserializationError error = deserializeJson(doc, bufferedFile);
-        if (error) {
+        dirty = true;
+        retval = decode_image_json(bufferedFile, leds, MTX_NUM_LEDS, &proxy_color_set, &proxy_color);
+        if (!retval) {
+            file.close();
             if (message) {
-                *message = F("set_image(): deserializeJson() failed.");
+                *message = F("set_image(): JSON image had error.");
             }
             return false;
         }
-
-        JsonObject object = doc.as<JsonObject>();
-
-        proxy_color_set = false;
-        if (!object[F("pc")].isNull()) {
-            std::string pc = object[F("pc")].as<std::string>();
-            if (!pc.empty()) {
-                proxy_color = std::stoul(pc, nullptr, 16);
-                proxy_color_set = true;
-            }
-        }
-
-        clear();
-        retval = deserializeSegment(object, leds, MTX_NUM_LEDS);
-        if (message) {
-            *message = F("set_image(): deserializeSegment() had error.");
-        }
     }
     file.close();
 
@@ -1567,21 +2296,17 @@ const uint8_t* ReAnimator::get_bitmap(const lv_font_t* f, uint32_t c, uint32_t n
         */
 
         uint16_t bufsize = width*height;
-        if (glyph_draw_buf != nullptr) {
-            delete glyph_draw_buf->data;
-            glyph_draw_buf->data = nullptr;
-            delete glyph_draw_buf;
-            glyph_draw_buf = nullptr;
+        if (glyph_draw_buf.data_size < bufsize) {
+            delete[] glyph_draw_buf.data;
+            glyph_draw_buf.data = new uint8_t[bufsize];
+            glyph_draw_buf.data_size = bufsize;
         }
-
-        glyph_draw_buf = new lv_draw_buf_t;
-        glyph_draw_buf->data = new uint8_t[bufsize];
         for (uint16_t i = 0; i < bufsize; i++) {
-          (glyph_draw_buf->data)[i] = 0;
+          (glyph_draw_buf.data)[i] = 0;
         }
 
-        font->get_glyph_bitmap(&g, glyph_draw_buf);
-        uint8_t* glyph = glyph_draw_buf->data;
+        font->get_glyph_bitmap(&g, &glyph_draw_buf);
+        uint8_t* glyph = glyph_draw_buf.data;
 
         // old approach works only works for 8 bpp fonts
         //const uint8_t* glyph = &fdsc->glyph_bitmap[gdsc->bitmap_index];
@@ -1817,6 +2542,7 @@ void ReAnimator::refresh_date_time(uint16_t draw_interval) {
 // ++++++++++++++++++++++++++++++
 // loop through all of the patterns
 void ReAnimator::autocycle() {
+    wake_by(autocycle_previous_millis + autocycle_interval + 1);
     if((millis() - autocycle_previous_millis) > autocycle_interval) {
         autocycle_previous_millis = millis();
         DEBUG_PRINTLN("autocycle started");
@@ -1829,6 +2555,7 @@ void ReAnimator::autocycle() {
 
 // alternate between running a pattern forwards or backwards
 void ReAnimator::flipflop() {
+    wake_by(flipflop_previous_millis + flipflop_interval + 1);
     if((millis() - flipflop_previous_millis) > flipflop_interval) {
         flipflop_previous_millis = millis();
         DEBUG_PRINTLN("flip flop loop started");
@@ -1842,7 +2569,7 @@ void ReAnimator::flipflop() {
 // ++++++++++++++++++++++++++++++
 // ++++++++ POSITIONING +++++++++
 // ++++++++++++++++++++++++++++++
-ReAnimator::Point ReAnimator::serp2cart(uint8_t i) {
+ReAnimator::Point ReAnimator::serp2cart(uint16_t i) {
     Point p;
     p.y = i/MTX_NUM_COLS;
     p.x = (p.y % 2) ? (MTX_NUM_COLS-1) - (i % MTX_NUM_COLS) : i % MTX_NUM_COLS;
@@ -1856,7 +2583,7 @@ int16_t ReAnimator::cart2serp(Point p) {
 }
 
 
-ReAnimator::Point ReAnimator::serp2cart_native(uint8_t i) {
+ReAnimator::Point ReAnimator::serp2cart_native(uint16_t i) {
     Point p;
     p.y = i/MTX_NUM_ROWS;
     p.x = (p.y % 2) ? (MTX_NUM_ROWS-1) - (i % MTX_NUM_ROWS) : i % MTX_NUM_ROWS;
@@ -1876,80 +2603,58 @@ int16_t ReAnimator::cart2serp_native(Point p) {
 //sx: + is WEST, - is EAST
 //sy: + is SOUTH, - is NORTH
 // where WEST means right to left, EAST means left to right, SOUTH means down, and NORTH means up
-uint16_t ReAnimator::translate(uint16_t i, int8_t xi, int8_t yi, int8_t sx, int8_t sy, bool wrap, int8_t gap) {
+//
+// translation is separable, so it is worked out one axis at a time. src[u] is set to the input position that is shown at
+// output position u along the axis, or 0xFF if no input is shown there. returns true if any input is visible along the axis.
+// len is the length of the axis, d is the current offset, and s is the step.
+bool ReAnimator::translate_axis(uint8_t src[], uint8_t len, int8_t d, int8_t s, bool wrap, int8_t gap) {
 // the origin of the matrix is in the NORTHEAST corner, so positive moves head WEST and SOUTH
 // this function's logic treats entering the matrix from the EAST border (WESTWARD movement) or NORTH border (SOUTHWARD movement)
 // as the basic case and flips those to get EAST and NORTH.
 // this approach simplifies the code because d and v will be positive (after transient period) 
 // which lets us just use mod to wrap the output instead of having to account for wrapping around
 // when d is positive or negative.
+    bool visible = false;
+    uint8_t g = (gap == -1) ? len : gap; // if gap is -1 set gap to len so that the input only appears in one place but will still loop around
 
-    if (t_initial) {
-        t_initial = false;
-        dx = (xi >= MTX_NUM_COLS) ? -abs(xi) : xi;
-        dy = (yi >= MTX_NUM_ROWS) ? -abs(yi) : yi;
-    }
+    for (uint8_t u = 0; u < len; u++) {
+        src[u] = 0xFF; // used to indicate pixel is not in bounds and should not be drawn.
 
-    uint16_t ti = MTX_NUM_LEDS; // used to indicate pixel is not in bounds and should not be drawn.
+        uint8_t uf = (s > 0) ? len-1-u : u; // flip heading that the output travels towards
+        int8_t v = uf+d; // shift input over into output by d
 
-    Point p1 = serp2cart(i);
-    Point p2;
+        if (t_has_entered && wrap) {
+            v = v % (len+g);
+        }
 
-    if (t_has_entered && !wrap && !t_visible) {
-        // wrapping is not turned on and input has passed through matrix never to return
-        return ti;
+        if (0 <= v && v < len) {
+            visible = true;
+            src[u] = (s > 0) ? len-1-v : v; // flip image
+        }
     }
+    return visible;
+}
 
-    t_visible = false;
-    
-    uint8_t gapx = (gap == -1) ? MTX_NUM_COLS : gap; // if gap is -1 set gap to MTX_NUM_COLS so that the input only appears in one place but will still loop around
-    uint8_t gapy = (gap == -1) ? MTX_NUM_ROWS : gap; // if gap is -1 set gap to MTX_NUM_ROWS so that the input only appears in one place but will still loop around
 
-    uint8_t ux = (sx > 0) ? MTX_NUM_COLS-1-p1.x: p1.x; // flip heading that the output travels towards
-    uint8_t uy = (sy > 0) ? MTX_NUM_ROWS-1-p1.y: p1.y;
+// advances the translation by one step
+void ReAnimator::translate_step(int8_t sx, int8_t sy, bool wrap, int8_t gap) {
+    uint8_t gapx = (gap == -1) ? MTX_NUM_COLS : gap;
+    uint8_t gapy = (gap == -1) ? MTX_NUM_ROWS : gap;
 
-    int8_t vx = ux+dx; // shift input over into output by dx
-    int8_t vy = uy+dy;
+    dx += abs(sx%MTX_NUM_COLS);
+    dy += abs(sy%MTX_NUM_ROWS);
+    // need to track when input has entered into view for the first time
+    // to prevent wrapping until the transient period has ended
+    // this allows controlling how long it takes the input to enter the matrix
+    // by setting abs(xi) or abs(yi) to higher numbers.
+    if (dx >= 0 && dy >= 0) {
+        t_has_entered = true;
+    }
 
     if (t_has_entered && wrap) {
-        vx = vx % (MTX_NUM_COLS+gapx);
-        vy = vy % (MTX_NUM_ROWS+gapy);
-    }
-
-    if ( 0 <= vx && vx < MTX_NUM_COLS && 0 <= vy && vy < MTX_NUM_ROWS ) {
-        t_visible = true;
-        vx = (sx > 0) ? MTX_NUM_COLS-1-vx : vx; // flip image
-        vy = (sy > 0) ? MTX_NUM_ROWS-1-vy : vy;
-        p2.x = vx;
-        p2.y = vy;
-        ti = cart2serp(p2);
-    }
-
-    // previously checked for end of data like this: if (i == MTX_NUM_LEDS-1)
-    // but transforming i to a different coordinate system results in i no longer
-    // being sequential so i == MTX_NUM_LEDS-1 may come up before all of the data
-    // has been passed to translate(). therefore we should count the pixels instead.
-    t_pixel_count++;
-    // not sure if I like stopping movement when frozen.
-    //if (t_pixle_count == MTX_NUM_LEDS && !freezer.is_frozen()) {
-    if (t_pixel_count == MTX_NUM_LEDS) {
-        t_pixel_count = 0;
-        dx += abs(sx%MTX_NUM_COLS);
-        dy += abs(sy%MTX_NUM_ROWS);
-        // need to track when input has entered into view for the first time
-        // to prevent wrapping until the transient period has ended
-        // this allows controlling how long it takes the input to enter the matrix
-        // by setting abs(xi) or abs(yi) to higher numbers.
-        if (dx >= 0 && dy >= 0) {
-            t_has_entered = true;
-        }
-
-        if (t_has_entered && wrap) {
-                dx = dx % (MTX_NUM_COLS+gapx);
-                dy = dy % (MTX_NUM_ROWS+gapy);
-        }
+            dx = dx % (MTX_NUM_COLS+gapx);
+            dy = dy % (MTX_NUM_ROWS+gapy);
     }
-    return ti;
 }
 
 
@@ -2020,8 +2725,9 @@ void ReAnimator::ntranslate(CRGBA in[], CRGBA out[], int8_t xi, int8_t yi, int8_
 }
 
 
-uint16_t ReAnimator::mover(uint16_t i) {
-    uint16_t ti;
+// translation parameters for each heading. see translate_axis() for what they mean.
+// returns false for heading 0 (stationary).
+bool ReAnimator::heading_translation(int8_t& xi, int8_t& yi, int8_t& sx, int8_t& sy) {
     // to be replaced by speed option in the future.
     int8_t s = 1;
     // add a bit of variability to the speed so moving objects do not always overlap in the same spot
@@ -2031,37 +2737,150 @@ uint16_t ReAnimator::mover(uint16_t i) {
     switch (heading) {
         default:
         case 0:
-            ti = i;
-            break;
+            return false;
         case 1:
-            ti = translate(i, 0, MTX_NUM_ROWS, 0, -s, true, -1);
+            xi = 0; yi = MTX_NUM_ROWS; sx = 0; sy = -s;
             break;
         case 2:
-            ti = translate(i, MTX_NUM_COLS, MTX_NUM_ROWS, -s, -s, true, -1);
+            xi = MTX_NUM_COLS; yi = MTX_NUM_ROWS; sx = -s; sy = -s;
             break;
         case 3:
-            ti = translate(i, MTX_NUM_COLS, 0, -s, 0, true, -1);
+            xi = MTX_NUM_COLS; yi = 0; sx = -s; sy = 0;
             break;
         case 4:
-            ti = translate(i, MTX_NUM_COLS, -MTX_NUM_ROWS, -s, s, true, -1);
+            xi = MTX_NUM_COLS; yi = -MTX_NUM_ROWS; sx = -s; sy = s;
             break;
         case 5:
-            ti = translate(i, 0, -MTX_NUM_ROWS, 0, s, true, -1);
+            xi = 0; yi = -MTX_NUM_ROWS; sx = 0; sy = s;
             break;
         case 6:
-            ti = translate(i, -MTX_NUM_COLS, -MTX_NUM_ROWS, s, s, true, -1);
+            xi = -MTX_NUM_COLS; yi = -MTX_NUM_ROWS; sx = s; sy = s;
             break;
         case 7:
-            ti = translate(i, -MTX_NUM_COLS, 0, s, 0, true, -1);
+            xi = -MTX_NUM_COLS; yi = 0; sx = s; sy = 0;
             break;
         case 8:
-            ti = translate(i, -MTX_NUM_COLS, MTX_NUM_ROWS, s, -s, true, -1);
+            xi = -MTX_NUM_COLS; yi = MTX_NUM_ROWS; sx = s; sy = -s;
             break;
     }
-    return ti;
+    return true;
+}
+
+
+void ReAnimator::mover_step() {
+    int8_t xi, yi, sx, sy;
+    if (heading_translation(xi, yi, sx, sy)) {
+        // not sure if I like stopping movement when frozen.
+        //if (!freezer.is_frozen()) {
+        translate_step(sx, sy, true, -1);
+        pixel_map_stale = true;
+    }
 }
 
 
+// the orientation and translation math used to be worked out for every pixel of every frame.
+// the result only changes when the heading or the translation offset changes, so work it out once and keep it in pixel_map[].
+void ReAnimator::build_pixel_map() {
+    uint8_t col_src[256];
+    uint8_t row_src[256];
+
+    int8_t xi, yi, sx, sy;
+    if (heading_translation(xi, yi, sx, sy)) {
+        if (t_initial) {
+            t_initial = false;
+            dx = (xi >= MTX_NUM_COLS) ? -abs(xi) : xi;
+            dy = (yi >= MTX_NUM_ROWS) ? -abs(yi) : yi;
+        }
+        t_visible = translate_axis(col_src, MTX_NUM_COLS, dx, sx, true, -1);
+        t_visible = translate_axis(row_src, MTX_NUM_ROWS, dy, sy, true, -1) && t_visible;
+    }
+    else {
+        for (uint8_t x = 0; x < MTX_NUM_COLS; x++) {
+            col_src[x] = x;
+        }
+        for (uint8_t y = 0; y < MTX_NUM_ROWS; y++) {
+            row_src[y] = y;
+        }
+    }
+
+    // q is a position in the layer, i is the LED that shows it, and ti is the pixel of leds[] that ends up there
+    Point q;
+    for (q.y = 0; q.y < MTX_NUM_ROWS; q.y++) {
+        for (q.x = 0; q.x < MTX_NUM_COLS; q.x++) {
+            uint16_t i;
+            if (MTX_ORIENTATION == 1) {
+                // rotated 90 degrees counterclockwise
+                Point p;
+                p.x = q.y;
+                p.y = MTX_NUM_COLS-1 - q.x;
+                i = cart2serp_native(p);
+            }
+            else {
+                i = cart2serp(q);
+            }
+
+            uint16_t ti = MTX_NUM_LEDS;
+            if (col_src[q.x] != 0xFF && row_src[q.y] != 0xFF) {
+                Point p2;
+                p2.x = col_src[q.x];
+                p2.y = row_src[q.y];
+                ti = cart2serp(p2);
+            }
+            pixel_map[i] = ti;
+        }
+    }
+    pixel_map_stale = false;
+}
+
+
+// leds[] was drawn on, so anything worked out from it has to be worked out again
+void ReAnimator::mark_leds_changed() {
+    coverage_stale = true;
+#ifdef PREMULTIPLIED_ALPHA
+    premul_stale = true;
+    leds_redrawn = true;
+#endif
+}
+
+
+void ReAnimator::update_coverage() {
+    if (!coverage_stale) {
+        return;
+    }
+
+    num_transparent = 0;
+    num_opaque = 0;
+    for (uint16_t i = 0; i < MTX_NUM_LEDS; i++) {
+        num_transparent += (leds[i].a == 0);
+        num_opaque += (leds[i].a == 255);
+    }
+
+    // the loader task may still be writing leds[], so count again next time
+    coverage_stale = (layer_type == Image_t && !image_dequeued);
+}
+
+
+#ifdef PREMULTIPLIED_ALPHA
+void ReAnimator::build_premultiplied(uint8_t alpha_scaling_factor) {
+    const bool substitute = (layer_type == Image_t && proxy_color_set);
+    for (uint16_t i = 0; i < MTX_NUM_LEDS; i++) {
+        CRGBA pixel = leds[i];
+        if (substitute && pixel == proxy_color) {
+            uint8_t alpha = pixel.a;
+            pixel = *rgb;
+            pixel.a = alpha;
+        }
+        pixel.a = scale8(pixel.a, alpha_scaling_factor);
+        premul_leds[i] = CPRGBA(pixel, layer_brightness);
+    }
+    premul_brightness = layer_brightness;
+
+    // the loader task may still be writing leds[], so build it again next time
+    premul_stale = (layer_type == Image_t && !image_dequeued);
+}
+#endif
+
+
 // ++++++++++++++++++++++++++++++
 // ++++++++++ HELPERS +++++++++++
 // ++++++++++++++++++++++++++++++
@@ -2104,23 +2923,34 @@ uint16_t ReAnimator::backwards(uint16_t index) {
 // function and an accent function are both called at the same time.
 // Patterns should use is_wait_over() and accents should use finished_waiting(). 
 bool ReAnimator::is_wait_over(uint16_t interval) {
+    bool over = false;
     if ( (millis() - iwopm) > interval ) {
         iwopm = millis();
-        return true;
-    }
-    else {
-        return false;
+        dirty = true; // patterns only change leds[] once their wait is over
+        over = true;
     }
+    wake_by(iwopm + interval + 1);
+    return over;
 }
 
 
 bool ReAnimator::finished_waiting(uint16_t interval) {
+    bool over = false;
     if ( (millis() - fwpm) > interval ) {
         fwpm = millis();
-        return true;
+        dirty = true; // accents only change leds[] or layer_brightness once their wait is over
+        over = true;
     }
-    else {
-        return false;
+    wake_by(fwpm + interval + 1);
+    return over;
+}
+
+
+// lowers the layer's deadline to t if t is sooner. see get_deadline().
+void ReAnimator::wake_by(uint32_t t) {
+    if (!wake_set || (int32_t)(t - wake_time) < 0) {
+        wake_time = t;
+        wake_set = true;
     }
 }
 
@@ -2180,6 +3010,7 @@ void ReAnimator::Freezer::timer(uint16_t freeze_interval) {
         m_frozen_previous_millis = m_pm;
         m_frozen = true;
     }
+    parent.wake_by(m_pm + freeze_interval + 1);
 }
 
 
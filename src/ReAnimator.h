@@ -24,7 +24,9 @@
 
 #include "project.h"
 #include "lvgl_fonts/lvgl/lvgl.h"
+#include "image_stats.h"
 #include <queue>
+#include <atomic>
 
 
 enum LayerType {Pattern_t = 0, Accent_t = 1, Image_t = 2, Text_t = 3, Info_t = 4};
@@ -44,10 +46,17 @@ enum Pattern {
 
 enum Accent {NO_ACCENT = 0, BREATHING = 1, FLICKER = 2, FROZEN_DECAY = 3};
 
+// the inner loops render_span() can use. see ReAnimator::blend_span().
+enum BlendKernel {NORMAL_BLEND = 0, XRAY_BLEND = 1, PROXY_BLEND = 2, OPAQUE_COPY = 3,
+                  PREMULTIPLIED_BLEND = 4, PREMULTIPLIED_COPY = 5};
+
 enum Info {TIME_12HR = 0, TIME_24HR = 1, DATE_MMDD = 2, DATE_DDMM = 3, TIME_12HR_DATE_MMDD = 4, TIME_24HR_DATE_DDMM = 5};
 
 
 class ReAnimator {
+    // the native benchmark (native/src/host_bench.cpp) times run_pattern() and apply_accent() directly
+    friend class LayerBench;
+
     // any changes to these values here will be overwritten
     // these values are set in the frontend
     // and their defaults are set in platformio.ini
@@ -58,6 +67,21 @@ class ReAnimator {
 
     CRGBA* leds;
 
+    // pixel_map[i] is the index into leds[] shown at LED i after orientation and movement are applied.
+    // it is MTX_NUM_LEDS where nothing is shown.
+    uint16_t* pixel_map;
+    bool pixel_map_stale;
+
+#ifdef PREMULTIPLIED_ALPHA
+    // leds[] with alpha premultiplied and the proxy color and layer_brightness already applied. it is what render_span()
+    // blends for every layer except xray patterns. leds[] stays straight alpha because effects read back what they drew.
+    CPRGBA* premul_leds;
+    bool premul_stale;
+    uint8_t premul_brightness;
+    bool leds_redrawn; // leds[] changed since the last render_span()
+    uint8_t rendered_brightness; // layer_brightness at the last render_span()
+#endif
+
     LayerType layer_type;
     int8_t id;
 
@@ -87,6 +111,7 @@ class ReAnimator {
     // if internal_rgb is user rgb points to that.
     CRGB internal_rgb;
     CRGB* rgb;
+    CRGB last_rgb; // value of *rgb at the last reanimate(), used to notice dynamic color changes
     uint8_t hue;
 
     void(*_cb)(uint8_t);
@@ -153,7 +178,17 @@ class ReAnimator {
     bool image_dequeued;
     bool image_loaded; // tracks whether image loading into leds[] has completed. helps prevent flicker by trying to display leds[] that is blank or has a partial image.
     bool image_clean; // tracks whether frozen decay (or possibly other accents) have corrupted the image indicating it needs a refresh
+    // the image as it was loaded, copied just before frozen decay first changes leds[] so it can be put back without reading flash.
+    // only layers that decay ever allocate it.
+    CRGBA* pristine_leds;
     uint32_t image_queued_time;
+    // image requests queued for the loader task that it has not finished with. it writes into the layer until then,
+    // so a deleted layer's slot is not given out again while this is above 0.
+    std::atomic<uint8_t> images_in_flight;
+    ImageTiming image_timing; // the steps of the last image request, see image_stats.h
+    bool image_timing_pending; // the image has not been composited yet, so its timing has not been added to the stats
+
+    struct ImageBatch;
 
     typedef struct Image {
       String* image_path;
@@ -164,9 +199,98 @@ class ReAnimator {
       bool* image_dequeued;
       bool* image_loaded;
       bool* image_clean;
+      int32_t frame; // -1 for an image, otherwise the frame to read from the sequence file at image_path
+      uint32_t* duration; // where a frame's duration goes. unused for images.
+      ImageTiming* timing; // where the loader task notes each step, or nullptr if no layer is waiting on the image
+      bool counted; // counted in pending_images until it is loaded
+      ImageBatch* batch; // set if this request is a whole batch, in which case only this is used
+      std::atomic<uint8_t>* in_flight; // the layer's count of requests the loader task has yet to finish, or nullptr
     } Image;
 
+    // every image a collection needs is sent to the loader task as one request. it reads them in one pass with one
+    // read buffer and wakes the render loop once they are all in. there is only one, so if a collection is loaded
+    // while the images of the last one are still being read, its images are requested one at a time instead.
+    struct ImageBatch {
+      Image images[NUM_LAYERS];
+      uint8_t count = 0;
+      bool open = false; // request_image() adds to the batch instead of queueing
+      bool dequeued = true; // the loader task is done with the batch
+    };
+
+    static ImageBatch image_batch;
+    // layer images queued but not loaded yet, plus sequences that have not shown their first frame
+    static std::atomic<uint16_t> pending_images;
+
     static QueueHandle_t qimages;
+    static TaskHandle_t image_notify_task;
+
+    // where the loader task decodes a prefetched image before adding it to the image cache. there is only one,
+    // so only one image is prefetched at a time and they do not hold up images that layers are waiting on.
+    typedef struct PrefetchSlot {
+      String image_path;
+      uint16_t num_leds = 0;
+      CRGBA* leds = nullptr;
+      bool proxy_color_set = false;
+      CRGB proxy_color;
+      bool image_dequeued = true;
+      bool image_loaded = false;
+      bool image_clean = false;
+    } PrefetchSlot;
+
+    static PrefetchSlot prefetch_slot;
+    static void load_image(Image& image, uint8_t* read_buffer = nullptr);
+    static void image_done(Image& image);
+
+    // a sequence layer shows one frame from the ring while the loader task reads the next ones into the others,
+    // so a sequence of any length is played with SEQUENCE_BUFFER_FRAMES frames in RAM. like the prefetch slot, the ring
+    // belongs to the class and not a layer, so a layer can be deleted while the loader task still has frames to read into it.
+    // there is only one, so only one layer at a time can play a sequence. they are always shown by themselves anyway.
+    typedef struct SequenceSlot {
+      String image_path;
+      uint16_t num_leds = 0;
+      CRGBA* leds = nullptr;
+      bool proxy_color_set = false;
+      CRGB proxy_color;
+      uint32_t duration = 0;
+      int32_t frame = -1; // the frame queued or held, -1 if the slot is free
+      bool image_dequeued = true;
+      bool image_loaded = false;
+      bool image_clean = false;
+    } SequenceSlot;
+
+    static SequenceSlot seq_slots[SEQUENCE_BUFFER_FRAMES];
+    uint16_t seq_num_frames; // 0 unless the layer is playing a sequence
+    uint16_t seq_next_read; // the next frame to queue
+    uint16_t seq_next_frame; // the next frame to show
+    int8_t seq_shown; // the slot leds[] was copied from, -1 before the first frame
+    uint32_t seq_deadline; // millis() at which the next frame is due
+    bool seq_looped;
+    bool seq_first_pending; // counted in pending_images until the first frame is shown
+    void end_sequence();
+
+    // layers and their pixel buffers are placed in one block reserved at boot (see reserve_layers()), so playlists that
+    // make and delete layers all day do not leave the heap in pieces. a layer that does not fit the pool uses the heap.
+    typedef struct LayerSlot {
+      void* object; // room for the ReAnimator itself
+      CRGBA* leds;
+      uint16_t* pixel_map;
+      uint8_t* pm_puck_dots;
+#ifdef PREMULTIPLIED_ALPHA
+      CPRGBA* premul_leds;
+#endif
+      bool in_use;
+      // the images_in_flight of the last layer in the slot, set when it is deleted. the loader task may still be
+      // writing an image into that layer, so the slot is skipped until it is 0.
+      const std::atomic<uint8_t>* images_in_flight;
+      uint32_t released; // of the free slots the one given back longest ago is reused first
+    } LayerSlot;
+
+    static LayerSlot* layer_slots;
+    static uint8_t num_layer_slots;
+    static uint16_t layer_slot_leds;
+    static uint32_t layer_slot_releases;
+    static uint32_t heap_layers;
+    LayerSlot* layer_slot; // where leds[] and the other buffers are, or nullptr if they are on the heap
 
     struct Point {
       uint8_t x;
@@ -175,7 +299,8 @@ class ReAnimator {
 
     const lv_font_t* font;
     uint8_t font_scale;
-    lv_draw_buf_t * glyph_draw_buf;
+    // every layer draws glyphs into the same buffer. it only grows, so text does not allocate for every character.
+    static lv_draw_buf_t glyph_draw_buf;
 
     struct fstring {
       std::string s;
@@ -203,11 +328,51 @@ class ReAnimator {
     uint32_t iwopm; // previous millis for is_wait_over()
     uint32_t fwpm ; // previous millis for finished_waiting()
 
+    // millis() by which reanimate() will have something to do again. every timer an effect waits on lowers it with wake_by().
+    uint32_t wake_time;
+    bool wake_set;
+    bool wake_every_frame; // set while the layer has to be redrawn before every frame no matter what its timers say
+
+    // set whenever something render_span() depends on changes. reanimate() reports and clears it.
+    bool dirty;
+
+    // how many pixels of leds[] are fully transparent and how many are fully opaque.
+    // they are counted again the first time they are needed after leds[] changes.
+    uint16_t num_transparent;
+    uint16_t num_opaque;
+    bool coverage_stale;
+
   public:
     uint32_t display_duration; // amount of time image is shown for if it is part of an animation
 
     ReAnimator(uint8_t num_rows, uint8_t num_cols, uint8_t orientation);
-    ~ReAnimator() { delete[] leds; leds = nullptr; delete[] pm_puck_dots; pm_puck_dots = nullptr;}
+    ~ReAnimator() {
+        if (layer_slot == nullptr) {
+            delete[] leds; delete[] pixel_map; delete[] pm_puck_dots;
+#ifdef PREMULTIPLIED_ALPHA
+            delete[] premul_leds;
+#endif
+        }
+        delete[] pristine_leds;
+        for (uint8_t i = 0; i < num_layer_slots; i++) {
+            if (layer_slots[i].object == this) {
+                layer_slots[i].images_in_flight = &images_in_flight;
+            }
+        }
+        leds = nullptr; pixel_map = nullptr; pm_puck_dots = nullptr; pristine_leds = nullptr;
+#ifdef PREMULTIPLIED_ALPHA
+        premul_leds = nullptr;
+#endif
+        end_sequence();
+    }
+
+    // reserves one block for count layers of a num_rows x num_cols matrix plus their pixel buffers, which new and delete
+    // then hand out and take back. call once at boot, before any layer is made. returns false if it was already called or out of memory.
+    static bool reserve_layers(uint8_t count, uint8_t num_rows, uint8_t num_cols);
+    static void* operator new(size_t size);
+    static void operator delete(void* p);
+    // slots in the pool, how many of them hold a layer, and how many layers have had to go on the heap since boot
+    static void layer_pool_stats(uint8_t& slots, uint8_t& in_use, uint32_t& on_heap);
 
     void setup(LayerType layer_type_in, int8_t id_in);
 
@@ -237,7 +402,26 @@ class ReAnimator {
 
     void set_image(String fs_path, uint32_t duration = REFRESH_INTERVAL, String* message = nullptr);
     static void load_image_from_queue(void* parameter);
+    // the task to notify (xTaskNotifyGive()) whenever the loader task finishes with an image, i.e. the one running show()
+    static void notify_on_image_load(TaskHandle_t task);
+    // has the loader task decode an image into the image cache before any layer shows it, so set_image() finds it there.
+    // returns true if the image is already cached or was queued, false if the last prefetch is still loading.
+    static bool prefetch_image(String id, uint16_t num_leds);
+    // images requested between these two calls are loaded as one batch. see ImageBatch.
+    static void begin_image_batch();
+    static void end_image_batch();
+    // true while any layer is waiting on the loader task. show() holds the display until every image is in.
+    static bool images_pending();
     int8_t get_image_status();
+    // call after every composited frame. the first one after an image is loaded ends its timing.
+    void report_image_shown();
+    // plays a sprite sheet animation (see sequence_file.h) of num_frames frames on an Image_t layer
+    void set_sequence(String fs_path, uint16_t num_frames);
+    bool is_sequence();
+    // true once after the last frame of a sequence is shown
+    bool sequence_looped();
+    // true while the frame a sequence should show now is still being read by the loader task
+    bool sequence_frame_pending();
     void set_text(std::string t);
     void set_info(Info id_in);
 
@@ -248,13 +432,24 @@ class ReAnimator {
     void set_heading(uint8_t h);
 
     void clear();
-    void reanimate();
-    CRGBA get_pixel(uint16_t i);
+    // returns true if what the layer shows has changed since the last call, i.e. it needs to be blended again
+    bool reanimate();
+    // the millis() value by which reanimate() needs to be called again. calling it earlier does nothing useful.
+    uint32_t get_deadline();
+    // true if reanimate() has something to do now, either because the deadline passed or because the layer
+    // changes every frame (a moving layer or a proxy color) or a setter changed it.
+    bool is_due();
+    void render_span(CRGB* dst, uint16_t start, uint16_t count);
+    void skip_span(uint16_t count);
+    bool is_transparent();
+    bool is_opaque();
 
   private:
     int8_t run_pattern(Pattern pattern);
     int8_t apply_accent(Accent accent);
     void refresh_text(uint16_t draw_interval);
+    void refresh_sequence();
+    void queue_sequence_frames();
     void refresh_info(uint16_t draw_interval);
 
 
@@ -325,8 +520,11 @@ class ReAnimator {
     void autocycle();
     void flipflop();
 
+    void request_image();
+
     bool is_wait_over(uint16_t interval);
     bool finished_waiting(uint16_t interval);
+    void wake_by(uint32_t t);
 
     void accelerate_decelerate_pattern(uint16_t draw_interval_initial, uint16_t delta_initial, uint16_t update_period, uint16_t genparam, void(ReAnimator::*pfp)(uint16_t, uint16_t, uint16_t(ReAnimator::*dfp)(uint16_t)), uint16_t(ReAnimator::*dfp)(uint16_t));
     void motion_blur(int8_t blur_num, uint16_t pos, uint16_t(ReAnimator::*dfp)(uint16_t));
@@ -334,13 +532,23 @@ class ReAnimator {
 
     static int compare(const void * a, const void * b);
 
-    Point serp2cart(uint8_t i);
+    Point serp2cart(uint16_t i);
     int16_t cart2serp(Point p);
-    Point serp2cart_native(uint8_t i);
+    Point serp2cart_native(uint16_t i);
     int16_t cart2serp_native(Point p);
-    uint16_t translate(uint16_t i, int8_t xi, int8_t yi, int8_t sx, int8_t sy, bool wrap, int8_t gap);
+    bool translate_axis(uint8_t src[], uint8_t len, int8_t d, int8_t s, bool wrap, int8_t gap);
+    void translate_step(int8_t sx, int8_t sy, bool wrap, int8_t gap);
     void ntranslate(CRGBA in[], CRGBA out[], int8_t xi = 0, int8_t yi = 0, int8_t sx = 1, int8_t sy = 1, bool wrap = true, int8_t gap = 0);
-    uint16_t mover(uint16_t i);
+    bool heading_translation(int8_t& xi, int8_t& yi, int8_t& sx, int8_t& sy);
+    void mover_step();
+    void build_pixel_map();
+    void mark_leds_changed();
+    void update_coverage();
+#ifdef PREMULTIPLIED_ALPHA
+    void build_premultiplied(uint8_t alpha_scaling_factor);
+#endif
+    template <BlendKernel kernel>
+    void blend_span(CRGB* dst, uint16_t start, uint16_t n, uint8_t brightness, uint8_t alpha_scaling_factor);
 
     //static void print_dt();
 
@@ -0,0 +1,197 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#include "compositor.h"
+
+
+static bool is_drawable(ReAnimator* layer) {
+  // it is possible the image may never load, so after so many attempts the image was
+  // marked as broken (-1) by get_image_status(). skip showing the image, but show the rest of the layers.
+  return (layer != nullptr && !(layer->get_type() == Image_t && layer->get_image_status() == -1));
+}
+
+
+bool composite(ReAnimator* layers[], uint8_t& sli, bool is_animation, CRGB* out, uint16_t num_leds, uint32_t& refresh_interval) {
+  bool loop_finished = false;
+  bool first_layer = true;
+
+  // everything under the topmost fully opaque layer is hidden, so blending starts there.
+  // an animation only shows one layer at a time.
+  int8_t base = -1;
+  int8_t top = is_animation ? sli : NUM_LAYERS-1;
+  for (int8_t i = top; i >= sli; i--) {
+    if (is_drawable(layers[i]) && layers[i]->is_opaque()) {
+      base = i;
+      break;
+    }
+  }
+
+  while (true) {
+    if (layers[sli] != nullptr) {
+      if (is_drawable(layers[sli])) {
+        if (first_layer) {
+          first_layer = false;
+          // data in out[] is written to a black background for first layer
+          // tried white and black bitmasks but clearing is around 10-50 microseconds faster
+          // an opaque base layer overwrites every pixel, so there is nothing to clear.
+          if (base == -1) {
+            memset((void*)out, 0, num_leds*sizeof(CRGB));
+          }
+        }
+        if ((int8_t)sli >= base && !layers[sli]->is_transparent()) {
+          layers[sli]->render_span(out, 0, num_leds);
+        }
+        else {
+          layers[sli]->skip_span(num_leds);
+        }
+        refresh_interval = layers[sli]->display_duration;
+      }
+    }
+    else if (is_animation) {
+      // empty (nullptr) layers need to have a duration of 0 in order to not stall the gif-like animation
+      refresh_interval = 0;
+    }
+
+    sli = (sli + 1) % NUM_LAYERS;
+    if (sli == 0 && is_animation) {
+      loop_finished = true;
+      break;
+    }
+    if (sli == 0 || is_animation) {
+      break;
+    }
+  }
+  return loop_finished;
+}
+
+
+static struct {
+  CRGB* from = nullptr;      // the outgoing frame
+  uint8_t* order = nullptr;  // when each LED switches over in a wipe or dissolve, 0 first and 255 last
+  uint16_t num_leds = 0;
+  uint8_t cols = 0;
+  uint8_t rows = 0;
+  uint8_t orientation = 0;
+  Transition type = NO_TRANSITION;
+  Transition order_type = NO_TRANSITION; // what order[] was last worked out for
+  uint32_t duration = 0;
+  uint32_t start = 0;
+  bool started = false;
+} transition;
+
+
+bool transition_init(uint8_t rows, uint8_t cols, uint8_t orientation) {
+  free(transition.from);
+  free(transition.order);
+  transition.num_leds = rows*cols;
+  transition.from = (CRGB*)malloc(transition.num_leds*sizeof(CRGB));
+  transition.order = (uint8_t*)malloc(transition.num_leds);
+  transition.rows = rows;
+  transition.cols = cols;
+  transition.orientation = orientation;
+  transition.type = NO_TRANSITION;
+  transition.order_type = NO_TRANSITION;
+  if (transition.from == nullptr || transition.order == nullptr) {
+    free(transition.from);
+    free(transition.order);
+    transition.from = nullptr;
+    transition.order = nullptr;
+    transition.num_leds = 0;
+    return false;
+  }
+  return true;
+}
+
+
+// the column LED i is in, counted from the same side ReAnimator draws x = 0 on. see ReAnimator::build_pixel_map().
+static uint8_t transition_column(uint16_t i) {
+  if (transition.orientation == 1) {
+    // rotated 90 degrees counterclockwise, so the native rows are the columns
+    uint8_t native_row = i/transition.rows;
+    return transition.cols-1 - native_row;
+  }
+  uint8_t y = i/transition.cols;
+  return (y % 2) ? (transition.cols-1) - (i % transition.cols) : i % transition.cols;
+}
+
+
+static void build_transition_order(Transition type) {
+  for (uint16_t i = 0; i < transition.num_leds; i++) {
+    if (type == WIPE) {
+      transition.order[i] = (transition.cols > 1) ? (transition_column(i)*255)/(transition.cols-1) : 0;
+    }
+    else {
+      // a fixed scramble instead of random8() so a dissolve does not change the random sequence the patterns see
+      transition.order[i] = ((uint32_t)i*2654435761u) >> 24;
+    }
+  }
+  transition.order_type = type;
+}
+
+
+void transition_start(const CRGB* last, Transition type, uint32_t duration) {
+  if (transition.from == nullptr || type == NO_TRANSITION || duration == 0) {
+    transition.type = NO_TRANSITION;
+    return;
+  }
+  memcpy((void*)transition.from, (const void*)last, transition.num_leds*sizeof(CRGB));
+  if ((type == WIPE || type == DISSOLVE) && transition.order_type != type) {
+    build_transition_order(type);
+  }
+  transition.type = type;
+  transition.duration = duration;
+  transition.started = false;
+}
+
+
+bool transition_apply(CRGB* out, uint16_t num_leds) {
+  if (transition.type == NO_TRANSITION || num_leds != transition.num_leds) {
+    return false;
+  }
+  if (!transition.started) {
+    transition.started = true;
+    transition.start = millis();
+  }
+
+  uint32_t elapsed = millis() - transition.start;
+  if (elapsed >= transition.duration) {
+    transition.type = NO_TRANSITION;
+    return false;
+  }
+  // how far along the transition is, 0 to 255
+  uint8_t progress = (elapsed*256)/transition.duration;
+
+  if (transition.type == CROSSFADE) {
+    fract8 amount = 255 - progress;
+    for (uint16_t i = 0; i < num_leds; i++) {
+      nblend(out[i], transition.from[i], amount);
+    }
+  }
+  else {
+    for (uint16_t i = 0; i < num_leds; i++) {
+      if (transition.order[i] >= progress) {
+        out[i] = transition.from[i];
+      }
+    }
+  }
+  return true;
+}
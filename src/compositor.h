@@ -0,0 +1,50 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "FastLED_RGBA.h"
+#include "ReAnimator.h"
+
+// the compositing half of blend_layers() in display.cpp
+
+// flattens layers[] into out[].
+// a composite blends every layer in one call. an animation shows one layer (frame) per call and sli tracks which frame is next.
+// refresh_interval is set to how long the result should be displayed for.
+// returns true when an animation has just shown its last frame, i.e. one loop of the animation has finished.
+bool composite(ReAnimator* layers[], uint8_t& sli, bool is_animation, CRGB* out, uint16_t num_leds, uint32_t& refresh_interval);
+
+// transitions blend the last frame of the playlist item being replaced into the first frames of the next one.
+// the outgoing frame is kept in a buffer allocated once by transition_init(), so a transition allocates nothing while it runs.
+enum Transition : uint8_t {NO_TRANSITION, CROSSFADE, WIPE, DISSOLVE};
+
+// sizes the buffers for the matrix. call again if the matrix size or orientation changes. returns false if out of memory.
+bool transition_init(uint8_t rows, uint8_t cols, uint8_t orientation);
+
+// keeps a copy of last[], the frame on display, to blend from. the transition starts the first time transition_apply() is called,
+// so it does not run down while the next item's images are loading.
+void transition_start(const CRGB* last, Transition type, uint32_t duration);
+
+// blends the kept frame over out[], which holds the incoming item's frame. returns true while a transition is running.
+bool transition_apply(CRGB* out, uint16_t num_leds);
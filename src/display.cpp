@@ -0,0 +1,711 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#include <LittleFS.h>
+#include <StreamUtils.h>
+#include "display.h"
+#include "compositor.h"
+#include "sequence_file.h"
+
+ReAnimator* layers[NUM_LAYERS];
+uint8_t ghost_layers[NUM_LAYERS] = {0};
+
+uint8_t gdynamic_hue = 0;
+uint8_t grandom_hue = 0;
+CRGB gdynamic_rgb = 0x000000;
+CRGB gdynamic_comp_rgb = 0x000000;
+
+bool playlist_enabled = false;
+uint16_t pl_item_loop_countdown = 0;
+
+uint8_t sli = 0;
+uint32_t show_refresh_interval = 0;
+uint32_t show_pm = 0;
+bool show_forced = true;
+
+String art_type = "";
+
+uint32_t gwake_time = 0;
+
+PlaylistState gplaylist;
+ScheduleState gschedule;
+PrefetchState gprefetch;
+
+static CRGB* leds = nullptr;
+static uint8_t num_rows = 0;
+static uint8_t num_cols = 0;
+static uint16_t num_leds = 0;
+static uint8_t orientation = 0;
+static DisplayHooks hooks = {nullptr, nullptr};
+
+static void puck_man_cb(uint8_t event);
+static bool is_valid_layer_json(JsonVariant layer_json);
+static bool load_layer(uint8_t lnum, JsonVariant layer_json);
+static bool load_image_to_layer(uint8_t lnum, String id, uint32_t image_duration = REFRESH_INTERVAL);
+static bool load_image_solo(String id);
+static bool read_collection(String type, String id, JsonDocument& doc);
+static bool load_collection_layers(JsonDocument& doc);
+static bool load_collection(String type, String id);
+static bool load_sequence(String id);
+static void prefetch_item(String type, String id);
+
+
+void display_begin(CRGB* output, uint8_t rows, uint8_t cols, uint8_t orient, const DisplayHooks& display_hooks) {
+  leds = output;
+  num_rows = rows;
+  num_cols = cols;
+  num_leds = rows*cols;
+  orientation = orient;
+  hooks = display_hooks;
+  transition_init(num_rows, num_cols, orientation);
+  ReAnimator::reserve_layers(NUM_LAYERS, num_rows, num_cols);
+
+  for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+    layers[i] = nullptr;
+    ghost_layers[i] = 0;
+  }
+
+  // initialzie dynamic colors because otherwise they won't be set until after layer.refresh() has been called which can lead to partially black text
+  gdynamic_rgb = CHSV(gdynamic_hue, 255, 255);
+  gdynamic_comp_rgb = CRGB::White - gdynamic_rgb;
+}
+
+
+void unload_layers(void) {
+  for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+    if (layers[i] != nullptr) {
+      delete layers[i];
+      layers[i] = nullptr;
+    }
+    ghost_layers[i] = 0;
+  }
+  show_forced = true;
+}
+
+
+static void puck_man_cb(uint8_t event) {
+  static bool one_shot = false;
+  switch (event) {
+    case 0:
+      one_shot = false;
+      for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+        if (ghost_layers[i] == 1) {
+          load_image_to_layer(i, "ghost_blinky");
+        }
+        if (ghost_layers[i] == 2) {
+          load_image_to_layer(i, "ghost_pinky");
+        }
+        if (ghost_layers[i] == 3) {
+          load_image_to_layer(i, "ghost_inky");
+        }
+        if (ghost_layers[i] == 4) {
+          load_image_to_layer(i, "ghost_clyde");
+        }
+      }
+      break;
+    case 1:
+      if (!one_shot) {
+        one_shot = true;
+        for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+          if (ghost_layers[i]) {
+            load_image_to_layer(i, "ghost_blue");
+          }
+        }
+      }
+      break;
+    case 2:
+      for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+        if (ghost_layers[i]) {
+          if (layers[i] != nullptr) {
+            layers[i]->clear();
+          }
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+
+static bool is_valid_layer_json(JsonVariant layer_json) {
+  if (layer_json[F("t")] == "e") {
+    return false;
+  }
+  if (layer_json[F("t")].isNull()) {
+    return false;
+  }
+  if (layer_json[F("id")].isNull()) {
+    return false;
+  }
+  if (layer_json[F("t")] == "w" && layer_json[F("w")].isNull()) {
+    return false;
+  }
+  if (layer_json[F("t")] == "im" && !hooks.image_exists(layer_json[F("id")].as<const char*>())) {
+    return false;
+  }
+  return true;
+}
+
+
+static bool load_layer(uint8_t lnum, JsonVariant layer_json) {
+  if (!is_valid_layer_json(layer_json)) {
+    if (layers[lnum] != nullptr) {
+      delete layers[lnum];
+      layers[lnum] = nullptr;
+    }
+    return false;
+  }
+
+  if (layers[lnum] == nullptr) {
+    layers[lnum] = new ReAnimator(num_rows, num_cols, orientation);
+  }
+
+  // sane defaults in case data is missing.
+  // if this data is missing from layer_json perhaps it is better to not show the layer at all.
+  uint8_t accent_id = 0;
+  uint8_t color_type = 1; // dynamic color
+  uint32_t color = 0x000000;
+  uint8_t movement = 0; // no movement
+  uint32_t image_duration = REFRESH_INTERVAL;
+
+  if (!layer_json[F("a")].isNull()) {
+    accent_id = layer_json[F("a")];
+  }
+
+  if (!layer_json[F("c")].isNull()) {
+    if (layer_json[F("c")].is<const char*>()) {
+      // fixed colors are stored as RGB hex in a string
+      const char* cs = layer_json[F("c")].as<const char*>();
+      if (strlen(cs) == 8 && cs[1] == 'x') {
+        color_type = 0;
+        color = strtoul(cs, NULL, 16);
+      }
+    }
+    else if (layer_json[F("c")].is<uint8_t>()) {
+      // dynamic colors are indicated by a number.
+      // might be able to use other number to indicate a particular color palette should be used.
+      color_type = layer_json[F("c")].as<uint8_t>();
+    }
+  }
+  
+  // the color setting of a layer is used for setting the color of a pattern and text
+  // but it is also used to replace the proxy color of an image
+
+  if (color_type == 0) {          
+    layers[lnum]->set_color(color);
+  }
+  else if (color_type == 2) {
+    layers[lnum]->set_color(&gdynamic_comp_rgb);
+  }
+  else {
+    layers[lnum]->set_color(&gdynamic_rgb);
+  }
+
+  if (!layer_json[F("m")].isNull()) {
+    movement = layer_json[F("m")];
+  }
+
+  if (!layer_json[F("d")].isNull()) {
+    image_duration = layer_json[F("d")];
+  }
+
+  ghost_layers[lnum] = 0;
+  if (layer_json[F("t")] == "im") {
+    String id = layer_json[F("id")].as<const char*>();
+    if (id == "ghost_blinky") {
+      ghost_layers[lnum] = 1;
+    }
+    if (id == "ghost_pinky") {
+      ghost_layers[lnum] = 2;
+    }
+    if (id == "ghost_inky") {
+      ghost_layers[lnum] = 3;
+    }
+    if (id == "ghost_clyde") {
+      ghost_layers[lnum] = 4;
+    }
+    layers[lnum]->setup(Image_t, -2);
+    if (!load_image_to_layer(lnum, id, image_duration)) {
+      return false;
+    }
+    layers[lnum]->set_accent(static_cast<Accent>(accent_id), true);
+    layers[lnum]->set_heading(movement);
+  }
+  else if (layer_json[F("t")] == "p") {
+    uint8_t id = layer_json[F("id")];
+    layers[lnum]->setup(Pattern_t, id);
+    layers[lnum]->set_cb(&puck_man_cb);
+    layers[lnum]->set_pattern(static_cast<Pattern>(id));
+    layers[lnum]->set_accent(static_cast<Accent>(accent_id), true);
+    layers[lnum]->set_heading(movement);
+  }
+  else if (layer_json[F("t")] == "w") {
+    layers[lnum]->setup(Text_t, -1);
+    layers[lnum]->set_text(layer_json[F("w")]);
+    layers[lnum]->set_accent(static_cast<Accent>(accent_id), true);
+    // direction is disabled for text in the frontend. setting to default of 0.
+    // if it is not set back to 0 on a layer that previously had movement the text
+    // will move.
+    layers[lnum]->set_heading(movement);
+  }
+  else if (layer_json[F("t")] == "n") {
+    uint8_t id = layer_json[F("id")];
+    layers[lnum]->setup(Info_t, id);
+    layers[lnum]->set_info(static_cast<Info>(id));
+    layers[lnum]->set_accent(static_cast<Accent>(accent_id), true);
+    layers[lnum]->set_heading(movement);
+  }
+  return true;
+}
+
+// this checks the layer and image exists before loading an image to it.
+// the idea is that the layer exists and we want to preserve all
+// its other attributes but replace its image.
+// this helps streamline code from having the same repeative layer and image
+// existence checks.
+static bool load_image_to_layer(uint8_t lnum, String id, uint32_t image_duration) {
+  if (layers[lnum] != nullptr) {
+    if (hooks.image_exists(id)) {
+      layers[lnum]->set_image(id, image_duration);
+      // since the image is loaded asynchronously using another core to prevent lag
+      // waiting to determine if the image was loaded successfully would defeat the purpose.
+      // so the best we can do is check if the image exists for indicating success.
+      // this file existence check helps playlist handling perform better because it means
+      // non-existent images can be skipped.
+      return true;
+    }
+    delete layers[lnum];
+    layers[lnum] = nullptr;
+    show_forced = true;
+  }
+  return false;
+}
+
+
+// this loads an image by itself (no other layers) to layer 0.
+static bool load_image_solo(String id) {
+  bool retval = false;
+  unload_layers();
+
+  if (layers[0] == nullptr) {
+    layers[0] = new ReAnimator(num_rows, num_cols, orientation);
+    layers[0]->setup(Image_t, -2);
+    retval = load_image_to_layer(0, id);
+    if (retval) {
+      layers[0]->set_color(&gdynamic_rgb);
+      layers[0]->set_heading(0);
+    }
+  }
+
+  return retval;
+}
+
+
+static bool read_collection(String type, String id, JsonDocument& doc) {
+  String fs_path = form_path(type, id, true);
+  File file = LittleFS.open(fs_path, "r");
+  
+  if (!file){
+    return false;
+  }
+
+  if (!file.available()) {
+    file.close();
+    return false;
+  }
+
+  ReadBufferingStream bufferedFile(file, 64);
+  DeserializationError error = deserializeJson(doc, bufferedFile);
+  file.close();
+
+  if (error) {
+    DEBUG_PRINT("deserializeJson() failed: ");
+    DEBUG_PRINTLN(error.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+static bool load_collection_layers(JsonDocument& doc) {
+  bool retval = false;
+  JsonObject object = doc.as<JsonObject>();
+  JsonArray layer_objects = object[F("l")];
+  if (!layer_objects.isNull() && layer_objects.size() > 0) {
+    // the images of every layer go to the loader task as one request
+    ReAnimator::begin_image_batch();
+    for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+      if (i < layer_objects.size()) {
+        retval = load_layer(i, layer_objects[i]) || retval;
+      }
+      else if (layers[i] != nullptr) {
+        // a collection with fewer layers than the one it replaces would otherwise leave the old ones showing
+        delete layers[i];
+        layers[i] = nullptr;
+        ghost_layers[i] = 0;
+      }
+    }
+    ReAnimator::end_image_batch();
+  }
+  return retval;
+}
+
+
+static bool load_collection(String type, String id) {
+  // use the copy read ahead by handle_prefetch() if it is still good
+  if (gprefetch.parsed && !gprefetch.stale && gprefetch.type == type && gprefetch.id == id) {
+    gprefetch.parsed = false;
+    return load_collection_layers(gprefetch.doc);
+  }
+
+  StaticJsonDocument<COLLECTION_DOC_SIZE> gcmdoc;
+  if (!read_collection(type, id, gcmdoc)) {
+    return false;
+  }
+  return load_collection_layers(gcmdoc);
+}
+
+
+// sprite sheet animations are played by layer 0 by itself, like an image shown by itself
+static bool load_sequence(String id) {
+  // the binary copy is made when the animation or one of its images is saved, or at boot if it is missing.
+  // an animation made of layers has one with no frames and fails here without its JSON being read.
+  String bin_path = sequence_bin_path(form_path(F("an"), id, true));
+  uint16_t num_frames = read_sequence_bin_header(bin_path, num_leds);
+  if (num_frames == 0) {
+    return false;
+  }
+
+  unload_layers();
+  layers[0] = new ReAnimator(num_rows, num_cols, orientation);
+  layers[0]->setup(Image_t, -2);
+  layers[0]->set_color(&gdynamic_rgb);
+  layers[0]->set_heading(0);
+  layers[0]->set_sequence(bin_path, num_frames);
+  return true;
+}
+
+
+static void prefetch_item(String type, String id) {
+  gprefetch.type = type;
+  gprefetch.id = id;
+  gprefetch.parsed = false;
+  gprefetch.pending = true;
+  gprefetch.next_layer = 0;
+}
+
+
+// does one step of reading ahead per call, so it never holds up loop() for longer than parsing one file.
+// images are queued one at a time and only once the layers being shown have their images, so a prefetch
+// never delays what is on the display. the loader task wakes loop() when each one is done.
+void handle_prefetch(void) {
+  if (!gprefetch.pending || !playlist_enabled || ReAnimator::images_pending()) {
+    return;
+  }
+
+  if (gprefetch.type == "im") {
+    if (!hooks.image_exists(gprefetch.id) || ReAnimator::prefetch_image(gprefetch.id, num_leds)) {
+      gprefetch.pending = false;
+    }
+  }
+  else if (gprefetch.type == "an" && read_sequence_bin_header(sequence_bin_path(form_path(F("an"), gprefetch.id, true)), num_leds) > 0) {
+    // a sprite sheet animation reads its own frames ahead once it is playing
+    gprefetch.pending = false;
+  }
+  else if (gprefetch.type == "cm" || gprefetch.type == "an") {
+    if (!gprefetch.parsed) {
+      gprefetch.stale = false;
+      gprefetch.parsed = read_collection(gprefetch.type, gprefetch.id, gprefetch.doc);
+      gprefetch.pending = gprefetch.parsed;
+      return;
+    }
+
+    JsonArray layer_objects = gprefetch.doc[F("l")];
+    while (gprefetch.next_layer < layer_objects.size()) {
+      JsonVariant layer_json = layer_objects[gprefetch.next_layer];
+      if (layer_json[F("t")] == "im" && hooks.image_exists(layer_json[F("id")].as<const char*>())) {
+        if (!ReAnimator::prefetch_image(layer_json[F("id")].as<const char*>(), num_leds)) {
+          // the last image is still loading
+          return;
+        }
+      }
+      gprefetch.next_layer++;
+    }
+    gprefetch.pending = false;
+  }
+  else {
+    gprefetch.pending = false;
+  }
+}
+
+
+bool load_from_playlist(String id) {
+  bool refresh_needed = false;
+  if (playlist_enabled) {
+    if (id != "") {
+      // should not do if (id != "" && id != gplaylist.id)
+      // because a playlist with an id matching gplaylist.id may have been edited,
+      // and therefore we would like to reload it to see the changes.
+      // calling with an id that is not blank means we want to load a new playlist so reinitialize everything
+      playlist_enabled = false;
+      gplaylist.id = id;
+      gplaylist.pm = 0; // using zero pm and item_interval ensures first item will be loaded immediately next time load_from_playlist() is called
+      gplaylist.item_interval = 0;
+      pl_item_loop_countdown = 0;
+      gplaylist.next_item = 0;
+      gplaylist.loaded = false;
+      gprefetch.pending = false;
+
+      if (!compile_playlist(form_path(F("pl"), id, true), gplaylist.playlist)) {
+        return refresh_needed;
+      }
+      playlist_enabled = true;
+      gplaylist.loaded = true;
+      // instead of loading the playlist and then loading the first item
+      // just load the playlist on this call, then the next call can load the first item
+      // returning now means less time is spent in this function when a new playlist is loaded
+      wake_by(millis());
+      return refresh_needed;
+    }
+
+    // there are two different ways to control how long a playlist item is show: by time or by loops for animations
+    // normally I would think to use || in a situation like this but && works better
+    // when an item is shown for an amount of time item_interval is set and pl_item_loop_countdown is always zero
+    // when an item is shown for a number of loops item_interval is always zero and pl_item_loop_countdown is set 
+    // this approach helps ensure the two different methods do not interfere with each other
+    const Playlist& playlist = gplaylist.playlist;
+    if (gplaylist.loaded && (millis()-gplaylist.pm) > gplaylist.item_interval && pl_item_loop_countdown == 0) {
+      if (gplaylist.next_item < playlist.items.size()) {
+        const PlaylistItem& item = playlist.items[gplaylist.next_item];
+        if (load_file(playlist_type_name(item.type), playlist.id(item))) {
+          // the minimums were applied when the playlist was compiled
+          gplaylist.item_interval = item.duration;
+          pl_item_loop_countdown = item.loops;
+          refresh_needed = true;
+          // leds[] still holds the last frame of the item being replaced
+          transition_start(leds, (Transition)item.transition, item.transition_duration);
+        }
+        else {
+          gplaylist.item_interval = 0;
+          pl_item_loop_countdown = 0;
+        }
+        gplaylist.next_item = (gplaylist.next_item+1) % playlist.items.size();
+        // read the next item ahead while this one is shown
+        const PlaylistItem& next = playlist.items[gplaylist.next_item];
+        prefetch_item(playlist_type_name(next.type), playlist.id(next));
+      }
+      else {
+        playlist_enabled = false;
+      }
+      // typically I would put this right after the if() check but I think putting it after load_file()
+      // removes some variability in the timing and may result in the art being shown for a period of
+      // time closer to what item_interval specifies
+      gplaylist.pm = millis();
+    }
+
+    if (gplaylist.loaded && pl_item_loop_countdown == 0) {
+      wake_by(gplaylist.pm + gplaylist.item_interval + 1);
+    }
+  }
+  return refresh_needed;
+}
+
+
+
+bool load_file(String type, String id) {
+  // reset show_refresh_interval to 0 when changing what is shown so there is not an unnecessary delay
+  // caused by the previous value of show_refresh_interval.
+  show_refresh_interval = 0;
+  // sli and pl_item_loop_countdown can be left in a unknown state if an animation is ended early, so reset them when loading a new file.
+  sli = 0;
+  pl_item_loop_countdown = 0;
+  show_forced = true;
+
+  bool retval = false;
+  art_type = type;
+  if (type == "im") {
+    retval = load_image_solo(id);
+  }
+  else if (type == "cm") {
+    retval = load_collection(type, id);
+  }
+  else if (type == "an") {
+    // a sprite sheet animation is shown by one layer, so it is composited like anything else and is not an "an" to show()
+    retval = load_sequence(id);
+    if (retval) {
+      art_type = "sq";
+    }
+    else {
+      retval = load_collection(type, id);
+    }
+  }
+  else if (type == "p") {
+    // a pattern by itself, where id is its number. the web interface only shows patterns as layers of a collection.
+    StaticJsonDocument<JSON_OBJECT_SIZE(2)> doc;
+    doc[F("t")] = "p";
+    doc[F("id")] = id.toInt();
+    unload_layers();
+    retval = load_layer(0, doc.as<JsonVariant>());
+  }
+  else if (type == "pl") {
+    art_type = "";
+    playlist_enabled = true;
+    // initialize playlist. its first item is loaded by the next call.
+    load_from_playlist(id);
+    retval = playlist_enabled;
+  }
+  else if (type == "sc") {
+    // what is shown now stays up until handle_schedule() loads the playlist of the rule in effect
+    art_type = "";
+    gschedule.id = id;
+    retval = compile_schedule(form_path(type, id, true), gschedule.schedule);
+    gschedule.next_fire = 0;
+    gschedule.stale = false;
+  }
+  return retval;
+}
+
+
+// loads the playlist of each schedule rule when it fires. the time only has to be compared against next_fire,
+// which is worked out again from the rule table each time a rule fires.
+bool handle_schedule(time_t now) {
+  if (gschedule.stale) {
+    gschedule.stale = false;
+    gschedule.next_fire = 0;
+    // if the file is gone this leaves no rules, but id is kept so the schedule starts again if it is saved
+    compile_schedule(form_path(F("sc"), gschedule.id, true), gschedule.schedule);
+  }
+  if (gschedule.schedule.rules.empty() || now < gschedule.next_fire) {
+    return false;
+  }
+
+  struct tm local_now;
+  localtime_r(&now, &local_now);
+  if (local_now.tm_year <= (2016 - 1900)) {
+    // no time from the ntp server yet. try again in a second.
+    gschedule.next_fire = now + 1;
+    return false;
+  }
+
+  const ScheduleRule& rule = schedule_active(gschedule.schedule, now);
+  gschedule.next_fire = schedule_next_fire(gschedule.schedule, now);
+  load_file(F("pl"), gschedule.schedule.id(rule));
+  return true;
+}
+
+
+// remembers changes reported between blends. a change can be reported while images are still loading or
+// before show_refresh_interval has passed, and it still needs to be shown once the blend block runs.
+static bool show_changed = true;
+// a transition blends every refresh until it is done, whether or not the layers changed
+static bool show_transitioning = false;
+
+
+void show(void) {
+  reanimate_layers();
+  blend_layers();
+}
+
+
+void reanimate_layers(void) {
+  for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+    if (layers[i] != nullptr) {
+      // draw layer. changes in layers are not displayed until they are copied to leds[] in the blend block
+      // a layer is only reanimated once it has something to do.
+      if (layers[i]->is_due()) {
+        if (layers[i]->reanimate()) {
+          show_changed = true;
+        }
+      }
+      if (layers[i]->sequence_looped() && pl_item_loop_countdown > 0) {
+        pl_item_loop_countdown--;
+      }
+      // layers that redraw before every frame are covered by the blend block's deadline
+      uint32_t deadline = layers[i]->get_deadline();
+      if ((int32_t)(deadline - millis()) > 0) {
+        wake_by(deadline);
+      }
+    }
+  }
+}
+
+
+bool blend_layers(void) {
+  bool refreshed = false;
+  // to prevent flickering do not show layers until all images are loaded.
+  // this is checked after reanimate_layers(), since a layer can ask for a new image while it is reanimated.
+  bool images_waiting = ReAnimator::images_pending();
+  uint32_t dt = millis()-show_pm;
+  if ((dt > show_refresh_interval) && !images_waiting) {
+    refreshed = true;
+    // the next refresh is due show_refresh_interval after this one was due, not after it happened, so a late loop()
+    // is made up on the next frame instead of slowing animations down. when more than a whole frame behind,
+    // e.g. after waiting on images, start over from now instead of rushing through frames to catch up.
+    // the empty frames at the end of an animation take no time, so being a little late for those is not falling behind.
+    show_pm += show_refresh_interval;
+    if ((millis()-show_pm) > max(show_refresh_interval, (uint32_t)REFRESH_INTERVAL)) {
+      show_pm = millis();
+    }
+    //if (dt > REFRESH_INTERVAL) {
+    //  DEBUG_PRINT("dt: ");
+    //  DEBUG_PRINTLN(dt);
+    //}
+    gdynamic_hue+=3;
+    gdynamic_rgb = CHSV(gdynamic_hue, 255, 255);
+    gdynamic_comp_rgb = CRGB::White - gdynamic_rgb;
+    grandom_hue = random8();
+
+    // most signage is static art, so skip the blend and the transmission (about 8 ms for 256 LEDs) when nothing changed.
+    // every frame of an animation is a different layer, so animations always need to be blended.
+    if (show_changed || show_forced || art_type == "an" || show_transitioning) {
+      show_changed = false;
+      show_forced = false;
+
+      if (composite(layers, sli, art_type == "an", leds, num_leds, show_refresh_interval)) {
+        pl_item_loop_countdown--;
+      }
+      show_transitioning = transition_apply(leds, num_leds);
+      if (show_transitioning) {
+        show_refresh_interval = min(show_refresh_interval, (uint32_t)TRANSITION_REFRESH_INTERVAL);
+      }
+      for (uint8_t i = 0; i < NUM_LAYERS; i++) {
+        if (layers[i] != nullptr) {
+          layers[i]->report_image_shown();
+        }
+      }
+      hooks.frame_ready(leds, num_leds);
+    }
+  }
+  // while images are loading the blend block waits on the loader task, which wakes loop() when it is done
+  if (!images_waiting) {
+    wake_by(show_pm + show_refresh_interval + 1);
+  }
+  return refreshed;
+}
+
+
+void wake_by(uint32_t t) {
+  if ((int32_t)(t - gwake_time) < 0) {
+    gwake_time = t;
+  }
+}
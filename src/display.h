@@ -0,0 +1,138 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+#include <FastLED.h>
+#include "FastLED_RGBA.h"
+#include "ArduinoJson-v6.h"
+#include "ReAnimator.h"
+#include "playlist_file.h"
+#include "schedule_file.h"
+#include "project.h"
+
+// what is shown on the LED matrix: the layers loaded from art files, the playlist and schedule stepping through them,
+// and show(), which reanimates the layers and blends them into leds[] every refresh.
+// main.cpp and the native host both run this. they only supply the clock for the schedule and the I/O in DisplayHooks.
+
+struct DisplayHooks {
+  // whether /files/im/<id>.json exists. the firmware checks its file list because LittleFS.exists() is much slower.
+  bool (*image_exists)(String id);
+  // show() has blended a new frame into leds[], which has to go out before the next one is blended
+  void (*frame_ready)(CRGB* leds, uint16_t num_leds);
+};
+
+// what a collection's JSON is parsed into: NUM_LAYERS layers of up to six members each and 64 bytes of strings.
+// that is 768 bytes on the ESP32. the slots are bigger where pointers are, so the native build gets the room it needs too.
+#define COLLECTION_DOC_SIZE (JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(NUM_LAYERS) + NUM_LAYERS*JSON_OBJECT_SIZE(6) + 64)
+
+// the playlist being shown, compiled when it is loaded. see compile_playlist() and load_from_playlist().
+struct PlaylistState {
+  String id;
+  Playlist playlist;
+  bool loaded = false;
+  uint16_t next_item = 0;       // index of the item load_from_playlist() loads next
+  uint32_t pm = 0;              // millis() the item being shown was loaded
+  uint32_t item_interval = 0;   // how long it is shown for, when it is shown for a time instead of a number of loops
+};
+
+// the schedule loading playlists by time of day, compiled when it is loaded. see compile_schedule() and handle_schedule().
+// it keeps running when something else is loaded by hand, and takes over again when its next rule fires.
+struct ScheduleState {
+  String id;               // the schedule file, which may not exist
+  Schedule schedule;
+  time_t next_fire = 0;    // when handle_schedule() has to load a playlist again. 0 loads the playlist of the rule in effect now.
+  bool stale = false;      // id was saved or deleted, so it has to be compiled again
+};
+
+// the next playlist item is read ahead while the current one is shown, so switching to it does not wait on flash.
+// a collection's file is parsed into doc, and its images (or the image of an im item) are decoded into the image cache
+// by the loader task one at a time. see handle_prefetch().
+struct PrefetchState {
+  String type;
+  String id;
+  StaticJsonDocument<COLLECTION_DOC_SIZE> doc;
+  bool parsed = false;     // doc holds the collection type/id
+  bool pending = false;    // there is still something to read ahead
+  uint8_t next_layer = 0;  // the next layer in doc whose image needs to be prefetched
+  bool stale = false;      // set by the web server when files change, since doc may no longer match what is on flash
+};
+
+extern ReAnimator* layers[NUM_LAYERS];
+extern uint8_t ghost_layers[NUM_LAYERS];
+
+extern uint8_t gdynamic_hue;
+extern uint8_t grandom_hue;
+extern CRGB gdynamic_rgb;
+extern CRGB gdynamic_comp_rgb; // complementary color to the dynamic color
+
+extern bool playlist_enabled;
+extern uint16_t pl_item_loop_countdown;
+
+// sli and show_refresh_interval must be global because they need to persistent between calls to show() for animations to work correctly
+extern uint8_t sli; // layer index for show()
+extern uint32_t show_refresh_interval; // refresh interval for show()
+// millis() the last refresh was due. the next one is due show_refresh_interval after it.
+extern uint32_t show_pm;
+// layers report their own changes through reanimate(), but adding or removing a layer changes the output too.
+// set show_forced to make show() blend and transmit the next frame even if no layer reports a change.
+extern bool show_forced;
+
+extern String art_type;
+
+// millis() by which loop() has to run again. anything waiting on a timer lowers it with wake_by().
+extern uint32_t gwake_time;
+
+extern PlaylistState gplaylist;
+extern ScheduleState gschedule;
+extern PrefetchState gprefetch;
+
+// sets up the layers for a rows x cols matrix blended into leds[]. call once from setup(), before the heap is fragmented,
+// since it reserves the layer pool and the transition buffer.
+void display_begin(CRGB* leds, uint8_t rows, uint8_t cols, uint8_t orientation, const DisplayHooks& hooks);
+
+// deletes every layer, so nothing is shown until something is loaded again
+void unload_layers(void);
+
+// loads art from /files. type is im, cm, an, pl, or sc, or p for a pattern by itself where id is its number. a playlist shows its first item on the next load_from_playlist().
+// a schedule leaves what is shown up until handle_schedule() loads the playlist of the rule in effect.
+bool load_file(String type, String id);
+
+// loads the next playlist item once the one being shown is done. with an id it loads that playlist instead.
+bool load_from_playlist(String id = "");
+// loads the playlist of the schedule rule in effect at now, if one has fired since the last call. returns true if one did.
+bool handle_schedule(time_t now);
+// does one step of reading the next playlist item ahead
+void handle_prefetch(void);
+
+// reanimate_layers() then blend_layers()
+void show(void);
+// redraws the layers that are due
+void reanimate_layers(void);
+// blends the layers into leds[] and hands the frame to DisplayHooks::frame_ready if the refresh interval is up and
+// something changed. returns true if the refresh interval was up.
+bool blend_layers(void);
+
+// lowers gwake_time to t if t is sooner
+void wake_by(uint32_t t);
@@ -0,0 +1,59 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// the ids named by a compiled file, e.g. the art of playlist items or the playlists of schedule rules. each id is kept once
+// no matter how many entries name it, and entries hold a 16 bit offset into the table so they stay small and fixed size.
+struct IdTable {
+  std::vector<char> chars; // each id once, ending in '\0'
+
+  const char* get(uint16_t offset) const { return &chars[offset]; }
+
+  // sets offset to where id starts, adding it if it is not there yet. fails if the table has no room left for it.
+  bool add(const char* id, uint16_t& offset) {
+    size_t i = 0;
+    while (i < chars.size()) {
+      const char* s = &chars[i];
+      if (strcmp(s, id) == 0) {
+        offset = i;
+        return true;
+      }
+      i += strlen(s) + 1;
+    }
+    size_t len = strlen(id) + 1;
+    if (i + len > UINT16_MAX) {
+      return false;
+    }
+    chars.insert(chars.end(), id, id + len);
+    offset = i;
+    return true;
+  }
+
+  // swap instead of clear() so the memory of a long table is given back
+  void clear() { std::vector<char>().swap(chars); }
+  void shrink_to_fit() { chars.shrink_to_fit(); }
+};
@@ -0,0 +1,172 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+
+#include <list>
+#include "image_cache.h"
+#include "image_file.h"
+#include "project.h"
+
+struct CachedImage {
+  String path;
+  uint8_t* data;   // packed by pack_image(), or the pixels as is if they could not be packed
+  size_t size;
+  bool packed;
+  uint16_t num_leds;
+  bool proxy_color_set;
+  CRGB proxy_color;
+};
+
+// most recently used at the front. there are only ever a handful of entries, so a linear search is fine.
+static std::list<CachedImage> cache;
+static SemaphoreHandle_t cache_mutex = nullptr;
+static ImageCacheStats stats = {0, 0, 0, 0, IMAGE_CACHE_BYTES, 0};
+
+
+void image_cache_init(void) {
+  if (cache_mutex == nullptr) {
+    cache_mutex = xSemaphoreCreateMutex();
+  }
+}
+
+
+static uint8_t* alloc_data(size_t bytes) {
+#if defined(BOARD_HAS_PSRAM)
+  if (psramFound()) {
+    return (uint8_t*)ps_malloc(bytes);
+  }
+#endif
+  return (uint8_t*)malloc(bytes);
+}
+
+
+static void drop(std::list<CachedImage>::iterator it) {
+  stats.bytes -= it->size;
+  stats.entries--;
+  free(it->data);
+  cache.erase(it);
+}
+
+
+static std::list<CachedImage>::iterator find(const String& path) {
+  for (auto it = cache.begin(); it != cache.end(); ++it) {
+    if (it->path == path) {
+      return it;
+    }
+  }
+  return cache.end();
+}
+
+
+bool image_cache_get(const String& path, CRGBA* leds, uint16_t num_leds, bool* proxy_color_set, CRGB* proxy_color) {
+  bool hit = false;
+  xSemaphoreTake(cache_mutex, portMAX_DELAY);
+  auto it = find(path);
+  if (it != cache.end() && it->num_leds == num_leds) {
+    if (it->packed) {
+      unpack_image(it->data, it->size, leds, num_leds);
+    }
+    else {
+      memcpy((void*)leds, (void*)it->data, it->size);
+    }
+    *proxy_color_set = it->proxy_color_set;
+    if (it->proxy_color_set) {
+      *proxy_color = it->proxy_color;
+    }
+    cache.splice(cache.begin(), cache, it);
+    hit = true;
+    stats.hits++;
+  }
+  else {
+    stats.misses++;
+  }
+  xSemaphoreGive(cache_mutex);
+  return hit;
+}
+
+
+bool image_cache_contains(const String& path, uint16_t num_leds) {
+  bool found = false;
+  xSemaphoreTake(cache_mutex, portMAX_DELAY);
+  auto it = find(path);
+  if (it != cache.end() && it->num_leds == num_leds) {
+    cache.splice(cache.begin(), cache, it);
+    found = true;
+  }
+  xSemaphoreGive(cache_mutex);
+  return found;
+}
+
+
+void image_cache_put(const String& path, const CRGBA* leds, uint16_t num_leds, bool proxy_color_set, CRGB proxy_color) {
+  // pixel art packs to a fraction of its size, so many more images fit in the budget.
+  // the packing is done before taking the mutex so layers reading the cache do not wait on it.
+  size_t pixel_bytes = num_leds*sizeof(CRGBA);
+  uint8_t* packed = (uint8_t*)malloc(pixel_bytes);
+  size_t bytes = packed ? pack_image(leds, num_leds, packed, pixel_bytes - 1) : 0;
+  bool is_packed = (bytes != 0);
+  if (!is_packed) {
+    bytes = pixel_bytes;
+  }
+  if (bytes > IMAGE_CACHE_BYTES) {
+    free(packed);
+    return;
+  }
+
+  xSemaphoreTake(cache_mutex, portMAX_DELAY);
+  auto it = find(path);
+  if (it != cache.end()) {
+    drop(it);
+  }
+  while (!cache.empty() && stats.bytes + bytes > IMAGE_CACHE_BYTES) {
+    drop(std::prev(cache.end()));
+    stats.evictions++;
+  }
+
+  uint8_t* data = alloc_data(bytes);
+  if (data) {
+    memcpy((void*)data, is_packed ? (void*)packed : (void*)leds, bytes);
+    cache.push_front({path, data, bytes, is_packed, num_leds, proxy_color_set, proxy_color});
+    stats.bytes += bytes;
+    stats.entries++;
+  }
+  xSemaphoreGive(cache_mutex);
+  free(packed);
+}
+
+
+void image_cache_forget(const String& path) {
+  xSemaphoreTake(cache_mutex, portMAX_DELAY);
+  auto it = find(path);
+  if (it != cache.end()) {
+    drop(it);
+  }
+  xSemaphoreGive(cache_mutex);
+}
+
+
+ImageCacheStats image_cache_stats(void) {
+  xSemaphoreTake(cache_mutex, portMAX_DELAY);
+  ImageCacheStats s = stats;
+  xSemaphoreGive(cache_mutex);
+  return s;
+}
@@ -0,0 +1,61 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "FastLED_RGBA.h"
+
+// decoded images kept in RAM so images that are shown over and over (Puck-Man's ghosts, an image refreshed after
+// frozen decay, the art in a playlist) are copied into a layer instead of being read from flash again.
+// entries are keyed by the image's path and the least recently used ones are dropped to stay under IMAGE_CACHE_BYTES.
+// images are kept packed (see pack_image()) when that makes them smaller.
+// when the board has PSRAM the pixels are kept there.
+// the loader task adds images on core 0 while layers read them on core 1, so every call takes a mutex.
+
+struct ImageCacheStats {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+  size_t bytes;     // bytes of packed or unpacked pixels currently held
+  size_t budget;    // IMAGE_CACHE_BYTES
+  uint16_t entries;
+};
+
+// creates the mutex. call once from setup() before the loader task or the web server can use the cache.
+void image_cache_init(void);
+
+// copies the cached image into leds[]. returns false, and leaves leds[] alone, if it is not cached for num_leds LEDs.
+bool image_cache_get(const String& path, CRGBA* leds, uint16_t num_leds, bool* proxy_color_set, CRGB* proxy_color);
+
+// true if the image is cached for num_leds LEDs. it is marked as recently used so it is kept for whoever asked.
+// does not count as a hit or a miss.
+bool image_cache_contains(const String& path, uint16_t num_leds);
+
+// adds a freshly decoded image, replacing any older copy
+void image_cache_put(const String& path, const CRGBA* leds, uint16_t num_leds, bool proxy_color_set, CRGB proxy_color);
+
+// drops an image that was changed or deleted on flash
+void image_cache_forget(const String& path);
+
+ImageCacheStats image_cache_stats(void);
@@ -0,0 +1,403 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+
+#include <LittleFS.h>
+#include <StreamUtils.h>
+#include "image_file.h"
+#include "JSON_Image_Decoder.h"
+
+static const uint8_t image_bin_magic[4] = {'P', 'X', 'I', 'M'};
+static const uint8_t image_bin_version_raw = 1;
+static const uint8_t image_bin_version_packed = 2;
+
+#define PACKED_HEADER_SIZE 2
+#define PACKED_MAX_RUN 128
+
+
+// CRGBA's == only compares r, g, and b
+static inline bool same_color(const CRGBA& a, const CRGBA& b) {
+  return memcmp((const void*)&a, (const void*)&b, sizeof(CRGBA)) == 0;
+}
+
+
+size_t pack_image(const CRGBA* leds, uint16_t num_leds, uint8_t* out, size_t out_size) {
+  if (num_leds == 0 || out_size < PACKED_HEADER_SIZE) {
+    return 0;
+  }
+
+  uint8_t* indexes = (uint8_t*)malloc(num_leds);
+  if (indexes == nullptr) {
+    return 0;
+  }
+
+  // the palette is built in out[] itself. neighboring pixels are usually the same color, so check the last one first.
+  CRGBA* palette = (CRGBA*)(out + PACKED_HEADER_SIZE);
+  uint16_t max_colors = min((size_t)256, (out_size - PACKED_HEADER_SIZE)/sizeof(CRGBA));
+  uint16_t num_colors = 0;
+  uint16_t last = 0;
+  for (uint16_t i = 0; i < num_leds; i++) {
+    if (num_colors == 0 || !same_color(palette[last], leds[i])) {
+      for (last = 0; last < num_colors && !same_color(palette[last], leds[i]); last++) {}
+      if (last == num_colors) {
+        if (num_colors == max_colors) {
+          free(indexes);
+          return 0;
+        }
+        palette[num_colors++] = leds[i];
+      }
+    }
+    indexes[i] = last;
+  }
+
+  uint8_t bits = (num_colors <= 16) ? 4 : 8;
+  out[0] = bits;
+  out[1] = num_colors - 1;
+  size_t n = PACKED_HEADER_SIZE + num_colors*sizeof(CRGBA);
+
+  uint16_t i = 0;
+  while (i < num_leds) {
+    uint16_t run = 1;
+    while (i + run < num_leds && run < PACKED_MAX_RUN && indexes[i + run] == indexes[i]) {
+      run++;
+    }
+
+    if (run >= 3 || i + run == num_leds) {
+      if (n + 2 > out_size) {
+        free(indexes);
+        return 0;
+      }
+      out[n++] = 0x80 | (run - 1);
+      out[n++] = indexes[i];
+      i += run;
+      continue;
+    }
+
+    // collect pixels one at a time until the next run of three or more
+    uint16_t count = 0;
+    while (i + count < num_leds && count < PACKED_MAX_RUN) {
+      uint16_t j = i + count;
+      if (j + 2 < num_leds && indexes[j] == indexes[j+1] && indexes[j] == indexes[j+2]) {
+        break;
+      }
+      count++;
+    }
+
+    size_t bytes = (bits == 8) ? count : (count + 1)/2;
+    if (n + 1 + bytes > out_size) {
+      free(indexes);
+      return 0;
+    }
+    out[n++] = count - 1;
+    if (bits == 8) {
+      memcpy(out + n, indexes + i, count);
+    }
+    else {
+      memset(out + n, 0, bytes);
+      for (uint16_t k = 0; k < count; k++) {
+        out[n + k/2] |= (k % 2) ? indexes[i + k] : indexes[i + k] << 4;
+      }
+    }
+    n += bytes;
+    i += count;
+  }
+
+  free(indexes);
+  return n;
+}
+
+
+bool unpack_image(const uint8_t* in, size_t in_size, CRGBA* leds, uint16_t num_leds) {
+  if (in_size < PACKED_HEADER_SIZE || (in[0] != 4 && in[0] != 8)) {
+    return false;
+  }
+  bool nibbles = (in[0] == 4);
+  uint16_t num_colors = in[1] + 1;
+  size_t p = PACKED_HEADER_SIZE + num_colors*sizeof(CRGBA);
+  if (p > in_size) {
+    return false;
+  }
+  // the colors are copied out because in[] has no particular alignment
+  CRGBA palette[256];
+  memcpy((void*)palette, in + PACKED_HEADER_SIZE, num_colors*sizeof(CRGBA));
+
+  uint16_t i = 0;
+  while (i < num_leds && p < in_size) {
+    uint8_t c = in[p++];
+    uint16_t count = (c & 0x7F) + 1;
+    if (i + count > num_leds) {
+      return false;
+    }
+
+    if (c & 0x80) {
+      if (p >= in_size || in[p] >= num_colors) {
+        return false;
+      }
+      CRGBA color = palette[in[p++]];
+      for (uint16_t k = 0; k < count; k++) {
+        leds[i++] = color;
+      }
+    }
+    else {
+      size_t bytes = nibbles ? (count + 1)/2 : count;
+      if (p + bytes > in_size) {
+        return false;
+      }
+      for (uint16_t k = 0; k < count; k++) {
+        uint8_t index = nibbles ? ((k % 2) ? in[p + k/2] & 0x0F : in[p + k/2] >> 4) : in[p + k];
+        if (index >= num_colors) {
+          return false;
+        }
+        leds[i++] = palette[index];
+      }
+      p += bytes;
+    }
+  }
+
+  return (i == num_leds && p == in_size);
+}
+
+
+String image_bin_path(const String& json_path) {
+  String bin_path = json_path;
+  if (bin_path.endsWith(".json")) {
+    bin_path.remove(bin_path.length()-5);
+  }
+  bin_path += IMAGE_BIN_EXT;
+  return bin_path;
+}
+
+
+// returns the number of pixels in the image, or 0 if header[] is not a binary image header
+static uint16_t parse_image_bin_header(const uint8_t* header, bool* proxy_color_set, CRGB* proxy_color) {
+  if (memcmp(header, image_bin_magic, sizeof(image_bin_magic)) != 0 ||
+      (header[4] != image_bin_version_raw && header[4] != image_bin_version_packed)) {
+    return 0;
+  }
+  if (proxy_color_set) {
+    *proxy_color_set = header[5] & 0x01;
+  }
+  if (proxy_color) {
+    *proxy_color = CRGB(header[8], header[9], header[10]);
+  }
+  return header[6] | (header[7] << 8);
+}
+
+
+bool read_image_bin(const String& path, CRGBA* leds, uint16_t num_leds, bool* proxy_color_set, CRGB* proxy_color, ImageTiming* timing, uint8_t* read_buffer) {
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+  ImageTiming scratch;
+  if (timing == nullptr) {
+    timing = &scratch;
+  }
+  timing->opened = micros();
+
+  bool retval = false;
+  uint8_t header[IMAGE_BIN_HEADER_SIZE];
+  bool pcs = false;
+  CRGB pc = CRGB::Black;
+  if (file.readBytes((char*)header, sizeof(header)) == sizeof(header)) {
+    uint16_t num_pixels = parse_image_bin_header(header, &pcs, &pc);
+    size_t pixel_bytes = num_pixels*sizeof(CRGBA);
+    // an image converted for a different size matrix is stale, and a short file was cut off while being written
+    if (num_pixels == num_leds && header[4] == image_bin_version_raw && file.size() == IMAGE_BIN_HEADER_SIZE + pixel_bytes) {
+      retval = (file.readBytes((char*)leds, pixel_bytes) == pixel_bytes);
+      timing->parsed = micros();
+    }
+    // packed pixels are only written when they are smaller than the pixels as is
+    else if (num_pixels == num_leds && header[4] == image_bin_version_packed && file.size() < IMAGE_BIN_HEADER_SIZE + pixel_bytes) {
+      size_t packed_bytes = file.size() - IMAGE_BIN_HEADER_SIZE;
+      uint8_t* packed = read_buffer ? read_buffer : (uint8_t*)malloc(packed_bytes);
+      if (packed) {
+        retval = (file.readBytes((char*)packed, packed_bytes) == packed_bytes);
+        timing->parsed = micros();
+        retval = retval && unpack_image(packed, packed_bytes, leds, num_leds);
+        if (packed != read_buffer) {
+          free(packed);
+        }
+      }
+    }
+  }
+  file.close();
+  timing->decoded = micros();
+
+  if (retval) {
+    *proxy_color_set = pcs;
+    if (pcs) {
+      *proxy_color = pc;
+    }
+  }
+  return retval;
+}
+
+
+bool write_image_bin(const String& path, const CRGBA* leds, uint16_t num_leds, bool proxy_color_set, CRGB proxy_color) {
+  size_t pixel_bytes = num_leds*sizeof(CRGBA);
+  uint8_t* packed = (uint8_t*)malloc(pixel_bytes);
+  size_t packed_bytes = packed ? pack_image(leds, num_leds, packed, pixel_bytes - 1) : 0;
+
+  uint8_t header[IMAGE_BIN_HEADER_SIZE] = {0};
+  memcpy(header, image_bin_magic, sizeof(image_bin_magic));
+  header[4] = packed_bytes ? image_bin_version_packed : image_bin_version_raw;
+  header[5] = proxy_color_set ? 0x01 : 0x00;
+  header[6] = num_leds & 0xFF;
+  header[7] = num_leds >> 8;
+  if (proxy_color_set) {
+    header[8] = proxy_color.r;
+    header[9] = proxy_color.g;
+    header[10] = proxy_color.b;
+  }
+
+  File file = LittleFS.open(path, "w");
+  if (!file) {
+    free(packed);
+    return false;
+  }
+  bool retval = (file.write(header, sizeof(header)) == sizeof(header));
+  if (packed_bytes) {
+    retval = retval && (file.write(packed, packed_bytes) == packed_bytes);
+  }
+  else {
+    retval = retval && (file.write((const uint8_t*)leds, pixel_bytes) == pixel_bytes);
+  }
+  file.close();
+  free(packed);
+
+  if (!retval) {
+    // a partial file would be rejected by read_image_bin() anyway, but do not leave it lying around
+    LittleFS.remove(path);
+  }
+  return retval;
+}
+
+
+bool write_image_json(const String& path, const CRGBA* leds, uint16_t num_leds, bool proxy_color_set, CRGB proxy_color) {
+  File file = LittleFS.open(path, "w");
+  if (!file) {
+    return false;
+  }
+
+  char token[32];
+  int n = snprintf(token, sizeof(token), "{\"t\":\"im\",");
+  bool retval = (file.write((const uint8_t*)token, n) == (size_t)n);
+  if (proxy_color_set) {
+    n = snprintf(token, sizeof(token), "\"pc\":\"%02x%02x%02x\",", proxy_color.r, proxy_color.g, proxy_color.b);
+    retval = retval && (file.write((const uint8_t*)token, n) == (size_t)n);
+  }
+  n = snprintf(token, sizeof(token), "\"i\":[");
+  retval = retval && (file.write((const uint8_t*)token, n) == (size_t)n);
+
+  // a run of one color is written as its start and stop indices followed by the color, a single pixel as just its color.
+  // every pixel is covered in order, so the position of a single pixel follows from the one before it.
+  uint16_t i = 0;
+  while (retval && i < num_leds) {
+    uint16_t stop = i + 1;
+    while (stop < num_leds && memcmp(&leds[stop], &leds[i], sizeof(CRGBA)) == 0) {
+      stop++;
+    }
+    const char* sep = (i == 0) ? "" : ",";
+    if (stop - i > 1) {
+      n = snprintf(token, sizeof(token), "%s%u,%u,\"%02x%02x%02x%02x\"", sep, i, stop, leds[i].r, leds[i].g, leds[i].b, leds[i].a);
+    }
+    else {
+      n = snprintf(token, sizeof(token), "%s\"%02x%02x%02x%02x\"", sep, leds[i].r, leds[i].g, leds[i].b, leds[i].a);
+    }
+    retval = (file.write((const uint8_t*)token, n) == (size_t)n);
+    i = stop;
+  }
+  retval = retval && (file.write((const uint8_t*)"]}", 2) == 2);
+  file.close();
+
+  if (!retval) {
+    LittleFS.remove(path);
+  }
+  return retval;
+}
+
+
+bool is_image_bin(const String& path, uint16_t num_leds) {
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+
+  bool retval = false;
+  uint8_t header[IMAGE_BIN_HEADER_SIZE];
+  if (file.readBytes((char*)header, sizeof(header)) == sizeof(header)) {
+    uint16_t num_pixels = parse_image_bin_header(header, nullptr, nullptr);
+    retval = (num_pixels == num_leds && header[4] == image_bin_version_raw && file.size() == IMAGE_BIN_HEADER_SIZE + num_pixels*sizeof(CRGBA));
+  }
+  file.close();
+
+  // the only way to know packed pixels are complete is to unpack them
+  if (!retval) {
+    CRGBA* leds = (CRGBA*)malloc(num_leds*sizeof(CRGBA));
+    if (leds) {
+      bool proxy_color_set;
+      CRGB proxy_color;
+      retval = read_image_bin(path, leds, num_leds, &proxy_color_set, &proxy_color);
+      free(leds);
+    }
+  }
+  return retval;
+}
+
+
+bool decode_image_json(Stream& input, CRGBA* leds, uint16_t num_leds, bool* proxy_color_set, CRGB* proxy_color) {
+  // for unknown reasons initializing the leds[] to all black
+  // makes the code slightly faster
+  for (uint16_t i = 0; i < num_leds; i++) leds[i] = CRGBA::Transparent;
+  return deserializeSegmentStream(input, leds, num_leds, proxy_color_set, proxy_color);
+}
+
+
+bool convert_image_json(const String& json_path, const String& bin_path, uint16_t num_leds) {
+  File file = LittleFS.open(json_path, "r");
+  CRGBA* leds = (CRGBA*)malloc(num_leds*sizeof(CRGBA));
+  if (!file || leds == nullptr) {
+    if (file) {
+      file.close();
+    }
+    free(leds);
+    return false;
+  }
+
+  bool retval = false;
+  ReadBufferingStream bufferedFile(file, 64);
+  bool proxy_color_set = false;
+  CRGB proxy_color = CRGB::Black;
+  if (decode_image_json(bufferedFile, leds, num_leds, &proxy_color_set, &proxy_color)) {
+    // written beside the old binary image and renamed over it, so the loader task never reads half of one
+    String tmp_path = bin_path + ".tmp";
+    retval = write_image_bin(tmp_path, leds, num_leds, proxy_color_set, proxy_color) && LittleFS.rename(tmp_path, bin_path);
+    if (!retval) {
+      LittleFS.remove(tmp_path);
+    }
+  }
+  file.close();
+
+  free(leds);
+  return retval;
+}
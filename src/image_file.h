@@ -0,0 +1,85 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "FastLED_RGBA.h"
+#include "image_stats.h"
+
+// images are saved as JSON ({"pc":"ff00ff", "i":[...]}) because that is what the web pages read and write,
+// but decoding that on every load takes tens of ms. so each image also gets a binary copy next to it,
+// e.g. /files/im/mona.rgba beside /files/im/mona.json, which can be read straight into a layer's leds[].
+//
+// binary image layout, all multibyte values little endian:
+//   0  'P' 'X' 'I' 'M'
+//   4  version. 1 if the pixels are stored as is, 2 if they are packed (see pack_image()).
+//   5  flags. bit 0 is set if the image has a proxy color.
+//   6  number of pixels
+//   8  proxy color as r, g, b
+//   11 reserved, 0
+//   12 version 1: the pixels as r, g, b, a in leds[] order
+//      version 2: the packed pixels, up to the end of the file
+//
+// pixel art rarely has more than a few dozen colors and often has large transparent areas, so images are packed
+// whenever they have 256 colors or fewer. packed pixels are a palette followed by run length encoded indices into it:
+//   0  bits per index, 4 if there are 16 colors or fewer, otherwise 8
+//   1  number of colors - 1
+//   2  the colors as r, g, b, a
+//   then runs until every pixel is covered, each starting with a count byte c:
+//     c & 0x80  (c & 0x7F) + 1 pixels of the color whose index is in the next byte
+//     otherwise c + 1 pixels each with their own index. 8 bit indices take a byte each, 4 bit indices are two
+//               to a byte, high nibble first, and an odd count leaves the last low nibble unused.
+#define IMAGE_BIN_EXT ".rgba" // same length as .json so file list code that strips the extension works for both
+#define IMAGE_BIN_HEADER_SIZE 12
+
+// packs leds[] into out[] as described above. returns the number of bytes used, or 0 if the image has more than
+// 256 colors or the packed pixels would not fit in out_size bytes.
+size_t pack_image(const CRGBA* leds, uint16_t num_leds, uint8_t* out, size_t out_size);
+
+// unpacks what pack_image() made into leds[] in one pass. fails if the data is corrupt or is not exactly num_leds pixels.
+bool unpack_image(const uint8_t* in, size_t in_size, CRGBA* leds, uint16_t num_leds);
+
+// the binary image path for a JSON image path from form_path()
+String image_bin_path(const String& json_path);
+
+// reads a binary image into leds[]. fails if the file is missing, is not a binary image, or was made for a different number of LEDs,
+// in which case the JSON image should be loaded instead. timing, if given, gets the opened, parsed, and decoded steps.
+// read_buffer, if given, must hold num_leds*sizeof(CRGBA) bytes and is used to read packed pixels instead of allocating.
+bool read_image_bin(const String& path, CRGBA* leds, uint16_t num_leds, bool* proxy_color_set, CRGB* proxy_color, ImageTiming* timing = nullptr,
+                    uint8_t* read_buffer = nullptr);
+
+// writes the packed version of the image when it is smaller, otherwise the pixels as is
+bool write_image_bin(const String& path, const CRGBA* leds, uint16_t num_leds, bool proxy_color_set, CRGB proxy_color);
+
+// writes leds[] as a JSON image in the form the web pages save, e.g. for an image that was uploaded as a binary image
+bool write_image_json(const String& path, const CRGBA* leds, uint16_t num_leds, bool proxy_color_set, CRGB proxy_color);
+
+// true if the file is a complete binary image for num_leds LEDs
+bool is_image_bin(const String& path, uint16_t num_leds);
+
+// decodes a JSON image into leds[] as it is read from input. leds[] not covered by the image are made transparent.
+bool decode_image_json(Stream& input, CRGBA* leds, uint16_t num_leds, bool* proxy_color_set, CRGB* proxy_color);
+
+// converts the JSON image file at json_path into a binary image at bin_path
+bool convert_image_json(const String& json_path, const String& bin_path, uint16_t num_leds);
@@ -0,0 +1,129 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+
+#include "image_stats.h"
+#include "project.h"
+
+static const char* const stage_names[IMAGE_STAGE_COUNT] = {"queue", "open", "parse", "decode", "show", "total", "cached"};
+
+// added to by loop() on core 1 and read by the web server, so every call takes a mutex
+static ImageStageStats stats[IMAGE_STAGE_COUNT];
+static SemaphoreHandle_t stats_mutex = nullptr;
+
+
+void image_stats_init(void) {
+  if (stats_mutex == nullptr) {
+    stats_mutex = xSemaphoreCreateMutex();
+  }
+}
+
+
+static void add(ImageStage stage, uint32_t us) {
+  ImageStageStats& s = stats[stage];
+  uint8_t bucket = 0;
+  while (bucket < IMAGE_STATS_BUCKETS-1 && (us >> (bucket+1)) != 0) {
+    bucket++;
+  }
+  s.buckets[bucket]++;
+  s.count++;
+  s.total_us += us;
+  s.max_us = max(s.max_us, us);
+}
+
+
+void image_stats_add(const ImageTiming& timing, uint32_t shown) {
+  xSemaphoreTake(stats_mutex, portMAX_DELAY);
+  if (timing.cached) {
+    add(IMAGE_STAGE_CACHED, shown - timing.queued);
+  }
+  else {
+    add(IMAGE_STAGE_QUEUE, timing.dequeued - timing.queued);
+    add(IMAGE_STAGE_OPEN, timing.opened - timing.dequeued);
+    add(IMAGE_STAGE_PARSE, timing.parsed - timing.opened);
+    add(IMAGE_STAGE_DECODE, timing.decoded - timing.parsed);
+    add(IMAGE_STAGE_SHOW, shown - timing.decoded);
+    add(IMAGE_STAGE_TOTAL, shown - timing.queued);
+  }
+  xSemaphoreGive(stats_mutex);
+}
+
+
+ImageStageStats image_stats_get(ImageStage stage) {
+  xSemaphoreTake(stats_mutex, portMAX_DELAY);
+  ImageStageStats s = stats[stage];
+  xSemaphoreGive(stats_mutex);
+  return s;
+}
+
+
+void image_stats_reset(void) {
+  xSemaphoreTake(stats_mutex, portMAX_DELAY);
+  memset(stats, 0, sizeof(stats));
+  xSemaphoreGive(stats_mutex);
+}
+
+
+String image_stats_json(void) {
+  String json = "{\"bucket_us\":\"2^i\",\"stages\":[";
+  for (uint8_t i = 0; i < IMAGE_STAGE_COUNT; i++) {
+    ImageStageStats s = image_stats_get(static_cast<ImageStage>(i));
+    json += String(i ? "," : "") + "{\"name\":\"" + stage_names[i] + "\",\"count\":" + String(s.count) +
+            ",\"mean_us\":" + String(s.count ? (uint32_t)(s.total_us/s.count) : 0) + ",\"max_us\":" + String(s.max_us) + ",\"buckets\":[";
+    for (uint8_t b = 0; b < IMAGE_STATS_BUCKETS; b++) {
+      json += String(b ? "," : "") + String(s.buckets[b]);
+    }
+    json += "]}";
+  }
+  json += "]}";
+  return json;
+}
+
+
+// the top of the bucket the pth percentile falls in
+static uint32_t percentile_us(const ImageStageStats& s, uint8_t p) {
+  uint32_t target = ((uint64_t)s.count*p + 99)/100;
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < IMAGE_STATS_BUCKETS; b++) {
+    seen += s.buckets[b];
+    if (seen >= target) {
+      return min((uint32_t)(2UL << b), s.max_us);
+    }
+  }
+  return s.max_us;
+}
+
+
+String image_stats_summary(void) {
+  char line[80];
+  String summary = "image stage   count   mean ms    p50 ms    p90 ms    max ms\n";
+  for (uint8_t i = 0; i < IMAGE_STAGE_COUNT; i++) {
+    ImageStageStats s = image_stats_get(static_cast<ImageStage>(i));
+    if (s.count == 0) {
+      continue;
+    }
+    snprintf(line, sizeof(line), "%-10s %8lu %9.2f %9.2f %9.2f %9.2f\n", stage_names[i], (unsigned long)s.count,
+             s.total_us/1000.0/s.count, percentile_us(s, 50)/1000.0, percentile_us(s, 90)/1000.0, s.max_us/1000.0);
+    summary += line;
+  }
+  return summary;
+}
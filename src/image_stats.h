@@ -0,0 +1,78 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+// how long each step of getting an image onto the display takes, so playlist timing and the loader task can be tuned.
+// every image a layer asks for is timed from set_image() to the first frame composited with it, as histograms per step.
+// images read ahead (prefetched images and the frames of a sprite sheet animation) have no layer waiting on them, so they are not timed.
+// timings come from micros(), so on the native build's virtual clock only the steps that wait on loop() take any time.
+
+// micros() at each step of one request. steps that did not happen are left 0.
+struct ImageTiming {
+  uint32_t queued;   // set_image() asked for the image
+  uint32_t dequeued; // the loader task took it off the queue
+  uint32_t opened;   // the file was open
+  uint32_t parsed;   // the file was read. JSON images are decoded while they are parsed, so for them this is also when they were decoded.
+  uint32_t decoded;  // the pixels were in leds[]
+  bool cached;       // copied from the image cache, so only queued and decoded are set
+};
+
+enum ImageStage {
+  IMAGE_STAGE_QUEUE = 0,  // queued to dequeued
+  IMAGE_STAGE_OPEN,       // dequeued to opened, including looking for a binary copy that is not there
+  IMAGE_STAGE_PARSE,      // opened to parsed
+  IMAGE_STAGE_DECODE,     // parsed to decoded
+  IMAGE_STAGE_SHOW,       // decoded to the first frame composited with the image, which includes adding it to the image cache
+  IMAGE_STAGE_TOTAL,      // queued to the first frame, for images read from flash
+  IMAGE_STAGE_CACHED,     // queued to the first frame, for images copied from the image cache
+  IMAGE_STAGE_COUNT
+};
+
+// bucket i counts times from 2^i us up to 2^(i+1) us. bucket 0 also counts 0 us and the last one everything longer.
+#define IMAGE_STATS_BUCKETS 24
+
+struct ImageStageStats {
+  uint32_t count;
+  uint64_t total_us;
+  uint32_t max_us;
+  uint32_t buckets[IMAGE_STATS_BUCKETS];
+};
+
+// creates the mutex. call once from setup() before anything is timed or the web server asks for the stats.
+void image_stats_init(void);
+
+// adds a request whose image was first composited at micros() shown
+void image_stats_add(const ImageTiming& timing, uint32_t shown);
+
+ImageStageStats image_stats_get(ImageStage stage);
+
+void image_stats_reset(void);
+
+// every stage with its histogram, for /image_stats.json
+String image_stats_json(void);
+
+// a line per stage with the count, mean, median, 90th percentile, and max in ms, for the debug console.
+// percentiles are the top of the bucket they fall in, so they are within a factor of 2.
+String image_stats_summary(void);
@@ -0,0 +1,71 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+
+#include "led_output.h"
+
+static CRGB* tx_leds = nullptr;
+static uint16_t tx_num_leds = 0;
+static QueueHandle_t qframes = nullptr; // brightness of the frame waiting in tx_leds[]
+static QueueHandle_t qtx_idle = nullptr; // holds a token while tx_leds[] is free to be overwritten
+
+
+static void transmit_frames(void*) {
+  uint8_t brightness;
+  uint8_t token = 0;
+  while (true) {
+    if (xQueueReceive(qframes, &brightness, portMAX_DELAY) == pdTRUE) {
+      FastLED.setBrightness(brightness);
+      FastLED.show();
+      xQueueSend(qtx_idle, &token, portMAX_DELAY);
+    }
+  }
+}
+
+
+void led_output_start(CRGB* tx, uint16_t num_leds) {
+  tx_leds = tx;
+  tx_num_leds = num_leds;
+  qframes = xQueueCreate(1, sizeof(uint8_t));
+  qtx_idle = xQueueCreate(1, sizeof(uint8_t));
+
+  uint8_t token = 0;
+  xQueueSend(qtx_idle, &token, 0);
+
+  TaskHandle_t Task2;
+  xTaskCreatePinnedToCore(transmit_frames, "Task2", 4096, NULL, 2, &Task2, 1);
+}
+
+
+void led_output_send(const CRGB* frame, uint8_t brightness) {
+  uint8_t token;
+  xQueueReceive(qtx_idle, &token, portMAX_DELAY);
+  memcpy((void*)tx_leds, (const void*)frame, tx_num_leds*sizeof(CRGB));
+  xQueueSend(qframes, &brightness, portMAX_DELAY);
+}
+
+
+void led_output_flush(void) {
+  uint8_t token;
+  xQueueReceive(qtx_idle, &token, portMAX_DELAY);
+  xQueueSend(qtx_idle, &token, portMAX_DELAY);
+}
@@ -0,0 +1,43 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+// double buffered LED output.
+// FastLED.show() blocks until every LED has been sent (about 30 ms for 1024 WS2812B LEDs), so instead of calling it from loop()
+// a finished frame is copied to the buffer FastLED transmits from and a task sends it. the next frame can then be
+// composited into leds[] while the previous one is still going out.
+
+// tx_leds is the buffer given to FastLED.addLeds(). it must not be touched once the output is started.
+// the task runs on core 1 alongside loop() at a higher priority, so a frame starts going out as soon as it is sent.
+void led_output_start(CRGB* tx_leds, uint16_t num_leds);
+
+// copies frame[] to tx_leds and queues it to be shown at brightness.
+// only waits if the previous frame has not finished going out yet.
+void led_output_send(const CRGB* frame, uint8_t brightness);
+
+// waits until the last frame sent has finished going out
+void led_output_flush(void);
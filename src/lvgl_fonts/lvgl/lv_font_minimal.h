@@ -4,6 +4,7 @@
 //extern "C" {
 //#endif
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
@@ -21,6 +21,12 @@
 
 #include "project.h"
 #include "ReAnimator.h"
+#include "display.h"
+#include "led_output.h"
+#include "image_file.h"
+#include "image_cache.h"
+#include "sequence_file.h"
+#include "image_stats.h"
 
 #define DATA_PIN 16
 #define COLOR_ORDER GRB
@@ -67,24 +73,12 @@ uint8_t ORIENTATION = 0;
 uint32_t LED_STRIP_MILLIAMPS = 375;  // 75% (safety margin) of 500 mA for a standard USB port a computer.
 
 CRGB* leds; // output
-
-ReAnimator* layers[NUM_LAYERS];
-uint8_t ghost_layers[NUM_LAYERS] = {0};
-
-uint8_t gdynamic_hue = 0;
-uint8_t grandom_hue = 0;
-CRGB gdynamic_rgb = 0x000000;
-CRGB gdynamic_comp_rgb = 0x000000; // complementary color to the dynamic color
+CRGB* tx_leds; // copy of leds[] that is being sent to the LED matrix. see led_output.h
 
 uint8_t homogenized_brightness = 255;
 
-bool playlist_enabled = false;
-
-// sli and show_refresh_interval must be global because they need to persistent between calls to show() for animations to work correctly
-uint8_t sli = 0; // layer index for show()
-uint32_t show_refresh_interval = 0; // refresh interval for show()
-
-String art_type = "";
+// the task running loop(). the image loader task notifies it when an image is done so loop() does not have to poll.
+TaskHandle_t gloop_task = nullptr;
 
 struct {
   String type;
@@ -96,11 +90,6 @@ const char* stored_file_list = FILE_ROOT "/file_list.txt";
 String patterns_json;
 String accents_json;
 
-// we have a JsonArray that needs to persist after load_from_playlist() exits,
-// therefore the document the JsonArray references must persist between function calls.
-//DynamicJsonDocument gpldoc(2048); //DynamicJsonDocument is recommended for documents larger than 1KB
-StaticJsonDocument<2048> gpldoc; // about 5 ms faster than DynamicJsonDocument. faster here compared to declaring as static inside load_from_playlist().
-
 void homogenize_brightness_custom(void);
 void homogenize_brightness_builtin(void);
 void homogenize_brightness(void);
@@ -114,15 +103,8 @@ std::set<std::string> load_file_list_from_disk(const char* filename);
 bool create_patterns_list(void);
 bool create_accents_list(void);
 bool save_data(String type, String id, String json, String* message = nullptr);
-void puck_man_cb(uint8_t event);
 bool image_exists(String id);
-bool is_valid_layer_json(JsonVariant layer_json);
-bool load_layer(uint8_t lnum, JsonVariant layer_json);
-bool load_image_to_layer(uint8_t lnum, String id, uint32_t image_duration = REFRESH_INTERVAL);
-bool load_image_solo(String id);
-bool load_collection(String type, String id);
-bool load_from_playlist(String id = "");
-bool load_file(String type, String id);
+void send_frame(CRGB* frame, uint16_t num_leds);
 void handle_ui_request(void);
 void write_log(String log_msg);
 
@@ -137,7 +119,6 @@ void mdns_setup(void);
 void web_server_station_setup(void);
 void web_server_ap_setup(void);
 void web_server_initiate(void);
-void show(void);
 
 
 // uses custom values for LED power usage.
@@ -314,6 +295,11 @@ void create_file_list(void) {
 
         while (File child = parent.openNextFile()) {
           String id = child.name();
+          if (id.endsWith(".tmp")) {
+            // left behind by an upload or a build that did not finish
+            child.close();
+            continue;
+          }
           id.remove(id.length()-5); // remove .json extension
 
           list_entry = parent.name();
@@ -343,8 +329,14 @@ void delete_files(String type, String id) {
         String filename = entry2.name();
         entry2.close();
         LittleFS.remove(fs_path+filename);
+        bool is_json = filename.endsWith(".json");
         filename.remove(filename.length()-5); // remove .json extension
         update_file_list(0, type, filename);
+        if (type == "im" && is_json) {
+          // the binary copy of the image is one of the files in the directory, but the cache and sequences are not
+          image_cache_forget(fs_path+filename+".json");
+          rebuild_sequences_using(filename, NUM_LEDS);
+        }
       }
       entry1.close();
       //LittleFS.rmdir(path);  // directories are used to indicate type and therefore should not be deleted
@@ -359,6 +351,87 @@ void delete_files(String type, String id) {
     // file does not actually exist but is still on file list, so remove it
     update_file_list(0, type, id);
   }
+
+  if (type == "im" && id != "") {
+    LittleFS.remove(image_bin_path(fs_path));
+    image_cache_forget(fs_path);
+    rebuild_sequences_using(id, NUM_LEDS);
+  }
+  if (type == "an" && id != "") {
+    LittleFS.remove(sequence_bin_path(fs_path));
+  }
+  if (type == "sc" && (id == "" || id == gschedule.id)) {
+    gschedule.stale = true;
+  }
+  gprefetch.stale = true;
+}
+
+
+// ids come from the web pages and become part of a path, so they must not lead out of their type's directory
+bool is_valid_id(const String& id) {
+  return id != "" && id.indexOf('/') < 0 && id.indexOf('\\') < 0 && id.indexOf("..") < 0;
+}
+
+
+// ids of binary images uploaded to /save, one per line. like deletions, what has to follow an upload is done in loop()
+// instead of in the web server's callbacks.
+String gimage_upload_list;
+void handle_image_uploads(void) {
+  while (gimage_upload_list != "") {
+    int f = gimage_upload_list.indexOf('\n');
+    String id = gimage_upload_list.substring(0, f);
+    gimage_upload_list = gimage_upload_list.substring(f+1);
+
+    // the web pages preview, edit, and back up the JSON, so it is written again from the binary image to match what is displayed
+    String fs_path = form_path(F("im"), id, true);
+    CRGBA* pixels = (CRGBA*)malloc(NUM_LEDS*sizeof(CRGBA));
+    bool proxy_color_set = false;
+    CRGB proxy_color = CRGB::Black;
+    if (!pixels || !read_image_bin(image_bin_path(fs_path), pixels, NUM_LEDS, &proxy_color_set, &proxy_color) ||
+        !write_image_json(fs_path, pixels, NUM_LEDS, proxy_color_set, proxy_color)) {
+      // an older JSON version of the image would no longer match what is displayed
+      LittleFS.remove(fs_path);
+    }
+    free(pixels);
+
+    update_file_list(1, "im", id);
+    image_cache_forget(fs_path);
+    rebuild_sequences_using(id, NUM_LEDS);
+    gprefetch.stale = true;
+  }
+}
+
+
+// images and animations saved to /save, as type/id one per line. their binary copies are made in loop(), since an
+// image can be in any number of sprite sheet animations and each one that shows it is built again.
+String gsave_list;
+void handle_save_list(void) {
+  while (gsave_list != "") {
+    int f = gsave_list.indexOf('\n');
+    String data = gsave_list.substring(0, f);
+    gsave_list = gsave_list.substring(f+1);
+    int di = data.indexOf('/');
+    String type = data.substring(0, di);
+    String id = data.substring(di+1);
+    String fs_path = form_path(type, id, true);
+
+    if (type == "im") {
+      // the JSON is kept for the web pages. the binary copy is what gets loaded onto the display.
+      // if the conversion fails remove any old copy so the image is loaded from the new JSON.
+      String bin_path = image_bin_path(fs_path);
+      if (!convert_image_json(fs_path, bin_path, NUM_LEDS)) {
+        LittleFS.remove(bin_path);
+      }
+      image_cache_forget(fs_path);
+      rebuild_sequences_using(id, NUM_LEDS);
+    }
+    else if (type == "an") {
+      // sprite sheet animations get a binary copy of their frames. animations made of layers get one with no frames
+      // that marks them as such.
+      build_sequence_bin(fs_path, sequence_bin_path(fs_path), NUM_LEDS);
+    }
+    gprefetch.stale = true;
+  }
 }
 
 
@@ -412,6 +485,17 @@ bool save_data(String type, String id, String json, String* message) {
     return false;
   }
 
+  if (type == "im" || type == "an") {
+    String entry = type + "/" + id + "\n";
+    if (gsave_list.indexOf(entry) < 0) {
+      gsave_list += entry;
+    }
+  }
+  if (type == "sc" && id == gschedule.id) {
+    gschedule.stale = true;
+  }
+  gprefetch.stale = true;
+
   if (message) {
     *message = F("save_data(): Data saved.");
   }
@@ -598,51 +682,6 @@ bool create_accents_list(void) {
 }
 
 
-void puck_man_cb(uint8_t event) {
-  static bool one_shot = false;
-  switch (event) {
-    case 0:
-      one_shot = false;
-      for (uint8_t i = 0; i < NUM_LAYERS; i++) {
-        if (ghost_layers[i] == 1) {
-          load_image_to_layer(i, "ghost_blinky");
-        }
-        if (ghost_layers[i] == 2) {
-          load_image_to_layer(i, "ghost_pinky");
-        }
-        if (ghost_layers[i] == 3) {
-          load_image_to_layer(i, "ghost_inky");
-        }
-        if (ghost_layers[i] == 4) {
-          load_image_to_layer(i, "ghost_clyde");
-        }
-      }
-      break;
-    case 1:
-      if (!one_shot) {
-        one_shot = true;
-        for (uint8_t i = 0; i < NUM_LAYERS; i++) {
-          if (ghost_layers[i]) {
-            load_image_to_layer(i, "ghost_blue");
-          }
-        }
-      }
-      break;
-    case 2:
-      for (uint8_t i = 0; i < NUM_LAYERS; i++) {
-        if (ghost_layers[i]) {
-          if (layers[i] != nullptr) {
-            layers[i]->clear();
-          }
-        }
-      }
-      break;
-    default:
-      break;
-  }
-}
-
-
 bool image_exists(String id) {
   // the file_list is used instead of LittleFS.exists() because exists() is a thousand or more times slower.
   String entry = "im";
@@ -652,349 +691,20 @@ bool image_exists(String id) {
 }
 
 
-bool is_valid_layer_json(JsonVariant layer_json) {
-  if (layer_json[F("t")] == "e") {
-    return false;
-  }
-  if (layer_json[F("t")].isNull()) {
-    return false;
-  }
-  if (layer_json[F("id")].isNull()) {
-    return false;
-  }
-  if (layer_json[F("t")] == "w" && layer_json[F("w")].isNull()) {
-    return false;
-  }
-  if (layer_json[F("t")] == "im" && !image_exists(layer_json[F("id")])) {
-    return false;
-  }
-  return true;
-}
-
-
-bool load_layer(uint8_t lnum, JsonVariant layer_json) {
-  if (!is_valid_layer_json(layer_json)) {
-    if (layers[lnum] != nullptr) {
-      delete layers[lnum];
-      layers[lnum] = nullptr;
-    }
-    return false;
-  }
-
-  if (layers[lnum] == nullptr) {
-    layers[lnum] = new ReAnimator(NUM_ROWS, NUM_COLS, ORIENTATION);
-  }
-
-  // sane defaults in case data is missing.
-  // if this data is missing from layer_json perhaps it is better to not show the layer at all.
-  uint8_t accent_id = 0;
-  uint8_t color_type = 1; // dynamic color
-  uint32_t color = 0x000000;
-  uint8_t movement = 0; // no movement
-  uint32_t image_duration = REFRESH_INTERVAL;
-
-  if (!layer_json[F("a")].isNull()) {
-    accent_id = layer_json[F("a")];
-  }
-
-  if (!layer_json[F("c")].isNull()) {
-    if (layer_json[F("c")].is<const char*>()) {
-      // fixed colors are stored as RGB hex in a string
-      const char* cs = layer_json[F("c")].as<const char*>();
-      if (strlen(cs) == 8 && cs[1] == 'x') {
-        color_type = 0;
-        color = strtoul(cs, NULL, 16);
-      }
-    }
-    else if (layer_json[F("c")].is<uint8_t>()) {
-      // dynamic colors are indicated by a number.
-      // might be able to use other number to indicate a particular color palette should be used.
-      color_type = layer_json[F("c")].as<uint8_t>();
-    }
-  }
-  
-  // the color setting of a layer is used for setting the color of a pattern and text
-  // but it is also used to replace the proxy color of an image
-
-  if (color_type == 0) {          
-    layers[lnum]->set_color(color);
-  }
-  else if (color_type == 2) {
-    layers[lnum]->set_color(&gdynamic_comp_rgb);
-  }
-  else {
-    layers[lnum]->set_color(&gdynamic_rgb);
-  }
-
-  if (!layer_json[F("m")].isNull()) {
-    movement = layer_json[F("m")];
-  }
-
-  if (!layer_json[F("d")].isNull()) {
-    image_duration = layer_json[F("d")];
-  }
-
-  ghost_layers[lnum] = 0;
-  if (layer_json[F("t")] == "im") {
-    String id = layer_json[F("id")];
-    if (id == "ghost_blinky") {
-      ghost_layers[lnum] = 1;
-    }
-    if (id == "ghost_pinky") {
-      ghost_layers[lnum] = 2;
-    }
-    if (id == "ghost_inky") {
-      ghost_layers[lnum] = 3;
-    }
-    if (id == "ghost_clyde") {
-      ghost_layers[lnum] = 4;
-    }
-    layers[lnum]->setup(Image_t, -2);
-    if (!load_image_to_layer(lnum, id, image_duration)) {
-      return false;
-    }
-    layers[lnum]->set_accent(static_cast<Accent>(accent_id), true);
-    layers[lnum]->set_heading(movement);
-  }
-  else if (layer_json[F("t")] == "p") {
-    uint8_t id = layer_json[F("id")];
-    layers[lnum]->setup(Pattern_t, id);
-    layers[lnum]->set_cb(&puck_man_cb);
-    layers[lnum]->set_pattern(static_cast<Pattern>(id));
-    layers[lnum]->set_accent(static_cast<Accent>(accent_id), true);
-    layers[lnum]->set_heading(movement);
-  }
-  else if (layer_json[F("t")] == "w") {
-    layers[lnum]->setup(Text_t, -1);
-    layers[lnum]->set_text(layer_json[F("w")]);
-    layers[lnum]->set_accent(static_cast<Accent>(accent_id), true);
-    // direction is disabled for text in the frontend. setting to default of 0.
-    // if it is not set back to 0 on a layer that previously had movement the text
-    // will move.
-    layers[lnum]->set_heading(movement);
-  }
-  else if (layer_json[F("t")] == "n") {
-    uint8_t id = layer_json[F("id")];
-    layers[lnum]->setup(Info_t, id);
-    layers[lnum]->set_info(static_cast<Info>(id));
-    layers[lnum]->set_accent(static_cast<Accent>(accent_id), true);
-    layers[lnum]->set_heading(movement);
-  }
-  return true;
-}
-
-// this checks the layer and image exists before loading an image to it.
-// the idea is that the layer exists and we want to preserve all
-// its other attributes but replace its image.
-// this helps streamline code from having the same repeative layer and image
-// existence checks.
-bool load_image_to_layer(uint8_t lnum, String id, uint32_t image_duration) {
-  if (layers[lnum] != nullptr) {
-    if (image_exists(id)) {
-      layers[lnum]->set_image(id, image_duration);
-      // since the image is loaded asynchronously using another core to prevent lag
-      // waiting to determine if the image was loaded successfully would defeat the purpose.
-      // so the best we can do is check if the image exists for indicating success.
-      // this file existence check helps playlist handling perform better because it means
-      // non-existent images can be skipped.
-      return true;
-    }
-    delete layers[lnum];
-    layers[lnum] = nullptr;
-  }
-  return false;
-}
-
-
-// this loads an image by itself (no other layers) to layer 0.
-bool load_image_solo(String id) {
-  bool retval = false;
-  for (uint8_t i = 0; i < NUM_LAYERS; i++) {
-    if (layers[i] != nullptr) {
-      delete layers[i];
-      layers[i] = nullptr;
-    }
-  }
-
-  if (layers[0] == nullptr) {
-    layers[0] = new ReAnimator(NUM_ROWS, NUM_COLS, ORIENTATION);
-    layers[0]->setup(Image_t, -2);
-    retval = load_image_to_layer(0, id);
-    if (retval) {
-      layers[0]->set_color(&gdynamic_rgb);
-      layers[0]->set_heading(0);
-    }
-  }
-
-  return retval;
-}
-
-
-bool load_collection(String type, String id) {
-  bool retval = false;
-  String fs_path = form_path(type, id, true);
-  File file = LittleFS.open(fs_path, "r");
-  
-  if (!file){
-    return false;
-  }
-
-  if (file.available()) {
-    StaticJsonDocument<768> gcmdoc;
-    ReadBufferingStream bufferedFile(file, 64);
-    DeserializationError error = deserializeJson(gcmdoc, bufferedFile);
-    file.close();
-
-    if (error) {
-      DEBUG_PRINT("deserializeJson() failed: ");
-      DEBUG_PRINTLN(error.c_str());
-      return false;
-    }
-
-    JsonObject object = gcmdoc.as<JsonObject>();
-    JsonArray layer_objects = object[F("l")];
-    if (!layer_objects.isNull() && layer_objects.size() > 0) {
-      for (uint8_t i = 0; i < layer_objects.size(); i++) {
-        if(layer_objects[i].is<JsonVariant>()) {
-          retval = load_layer(i, layer_objects[i]) || retval;
-        }
-      }
-    }
-  }
-
-  return retval;
-}
-
-
-uint16_t pl_item_loop_countdown = 0;
-bool load_from_playlist(String id) {
-  const uint32_t min_interval = 200; // milliseconds
-  const uint16_t min_loops = 1;
-  bool refresh_needed = false;
-  if (playlist_enabled) {
-    static String resume_id;
-    static uint32_t pm = 0;
-    static uint32_t item_interval = 0;
-    static uint8_t i = 0;
-    static JsonArray playlist;
-    static bool playlist_loaded = false;
-
-    if (id != "") {
-      // should not do if (id != "" && id != resume_id)
-      // because a playlist with an id matching resume_id may have been edited,
-      // and therefore we would like to reload it to see the changes.
-      // calling with an id that is not blank means we want to load a new playlist so reinitialize everything
-      playlist_enabled = false;
-      resume_id = id;
-      pm = 0; // using zero pm and item_interval ensures first item will be loaded immediately next time load_from_playlist() is called
-      item_interval = 0;
-      pl_item_loop_countdown = 0;
-      i = 0;
-      playlist_loaded = false;
-
-      String fs_path = form_path(F("pl"), id, true);
-      File file = LittleFS.open(fs_path, "r");
-      if (file && file.available()) {
-        ReadBufferingStream bufferedFile(file, 64);
-        DeserializationError error = deserializeJson(gpldoc, bufferedFile);
-        file.close();
-        if (error) {
-          DEBUG_PRINT("deserializeJson() failed: ");
-          DEBUG_PRINTLN(error.c_str());
-          playlist_enabled = false;
-          return refresh_needed;
-        }
-        JsonObject object = gpldoc.as<JsonObject>();
-        if (!object[F("pl")].isNull() && object[F("pl")].size() > 0) {
-          playlist = object[F("pl")];
-          playlist_enabled = true;
-          playlist_loaded  = true;
-          // instead of loading the playlist and then loading the first item
-          // just load the playlist on this call, then the next call can load the first item
-          // returning now means less time is spent in this function when a new playlist is loaded
-          return refresh_needed;
-        }
-      }
-    }
-
-    // there are two different ways to control how long a playlist item is show: by time or by loops for animations
-    // normally I would think to use || in a situation like this but && works better
-    // when an item is shown for an amount of time item_interval is set and pl_item_loop_countdown is always zero
-    // when an item is shown for a number of loops item_interval is always zero and pl_item_loop_countdown is set 
-    // this approach helps ensure the two different methods do not interfere with each other
-    if (playlist_loaded && (millis()-pm) > item_interval && pl_item_loop_countdown == 0) {
-      item_interval = 1000; // set to a safe value which will be replaced below
-      if(playlist[i].is<JsonVariant>()) {
-        JsonVariant item = playlist[i];
-        if(load_file(item[F("t")], item[F("id")])) {
-          if(item[F("d")].is<JsonInteger>()) {
-            if (item[F("t")] == "an") {
-              pl_item_loop_countdown = item[F("d")];
-              pl_item_loop_countdown = max(pl_item_loop_countdown, min_loops);
-              item_interval = 0;
-            }
-            else {
-              item_interval = item[F("d")];
-              // it takes a bit under 100 ms to load an image
-              // item_intervals of around 100 ms and less can cause the display to appear stalled or act erratic and causes a crash
-              // therefore the minimum item_interval is limited to 200 ms
-              // as a side note animations can have shorter delays than 200 ms because all of the images are loaded into layers at
-              // the same time and the layers are shown one at time, so individual images are not loaded from disk each time a new
-              // frame of the animation is shown
-              item_interval = max(item_interval, min_interval);
-              pl_item_loop_countdown = 0;
-            }
-          }
-          refresh_needed = true;
-        }
-        else {
-          item_interval = 0;
-          pl_item_loop_countdown = 0;
-        }
-        if (playlist.size() > 0) {
-          i = (i+1) % playlist.size();
-        }
-      }
-      else {
-        playlist_enabled = false;
-      }
-      // typically I would put this right after the if() check but I think putting it after load_file()
-      // removes some variability in the timing and may result in the art being shown for a period of
-      // time closer to what item_interval specifies
-      pm = millis();
-    }
-  }
-  return refresh_needed;
-}
-
-
-
-bool load_file(String type, String id) {
-  // reset show_refresh_interval to 0 when changing what is shown so there is not an unnecessary delay
-  // caused by the previous value of show_refresh_interval.
-  show_refresh_interval = 0;
-  // sli and pl_item_loop_countdown can be left in a unknown state if an animation is ended early, so reset them when loading a new file.
-  sli = 0;
-  pl_item_loop_countdown = 0;
+// show() has blended a new frame into leds[]. it is dimmed to stay within the power budget and sent to the LEDs.
+void send_frame(CRGB* frame, uint16_t num_leds) {
+#if HOMOGENIZE_BRIGHTNESS
+  homogenize_brightness();
+#endif
+  // safety measure while testing
+  //if (homogenized_brightness > 128) {
+  //  DEBUG_PRINT("homogenized_brightness > 128: ");
+  //  DEBUG_PRINTLN(homogenized_brightness);
+  //  homogenized_brightness = 128;
+  //}
 
-  bool retval = false;
-  art_type = type;
-  if (type == "im") {
-    retval = load_image_solo(id);
-  }
-  else if (type == "cm") {
-    retval = load_collection(type, id);
-  }
-  else if (type == "an") {
-    retval = load_collection(type, id);
-  }
-  else if (type == "pl") {
-    art_type = "";
-    playlist_enabled = true;
-    // initialize playlist
-    retval = load_from_playlist(id);
-  }
-  return retval;
+  // the frame goes out while the next one is composited
+  led_output_send(frame, homogenized_brightness);
 }
 
 
@@ -1272,6 +982,41 @@ void web_server_station_setup(void) {
     int rc = 400;
     String message = "Unknown error.";
 
+    if (!request->hasParam("json", true)) {
+      // a binary image was uploaded as a file instead. the upload handler below wrote it beside the image, and it
+      // only replaces the image once it is known to be complete. the rename leaves the loader task either the old
+      // image or the new one, never part of one.
+      String id;
+      int params = request->params();
+      for (int i = 0; i < params; i++) {
+        AsyncWebParameter* p = request->getParam(i);
+        if (p->isFile() && p->value().endsWith(IMAGE_BIN_EXT)) {
+          id = p->value().substring(0, p->value().length()-strlen(IMAGE_BIN_EXT));
+        }
+      }
+      String bin_path = image_bin_path(form_path("im", id, true));
+      String tmp_path = bin_path + ".tmp";
+      bool valid = is_valid_id(id) && is_image_bin(tmp_path, NUM_LEDS) && LittleFS.rename(tmp_path, bin_path);
+      if (!valid && is_valid_id(id)) {
+        LittleFS.remove(tmp_path);
+      }
+      if (valid) {
+        gimage_upload_list += id;
+        gimage_upload_list += "\n";
+        if (!request->hasParam("load", true) || request->getParam("load", true)->value() == "true") {
+          ui_request.type = "im";
+          ui_request.id = id;
+        }
+        message = "save_data(): Data saved.";
+        rc = 200;
+      }
+      else {
+        message = "Invalid binary image.";
+      }
+      request->send(rc, "application/json", "{\"message\": \""+message+"\"}");
+      return;
+    }
+
     String type = request->getParam("t", true)->value();
     String id = request->getParam("id", true)->value();
     String json = request->getParam("json", true)->value();
@@ -1297,6 +1042,27 @@ void web_server_station_setup(void) {
     }
 
     request->send(rc, "application/json", "{\"message\": \""+message+"\"}");
+  }, [](AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
+    // binary images can be uploaded to /save as a file named <id>.rgba. they are written as is to <id>.rgba.tmp and
+    // checked by the request handler above once complete.
+    if (!filename.endsWith(IMAGE_BIN_EXT)) {
+      return;
+    }
+    String id = filename.substring(0, filename.length()-strlen(IMAGE_BIN_EXT));
+    if (!is_valid_id(id)) {
+      return;
+    }
+    if (index == 0) {
+      String bin_path = image_bin_path(form_path("im", id, true));
+      create_dirs(bin_path.substring(0, bin_path.lastIndexOf("/")+1));
+      request->_tempFile = LittleFS.open(bin_path + ".tmp", "w");
+    }
+    if (request->_tempFile) {
+      request->_tempFile.write(data, len);
+      if (final) {
+        request->_tempFile.close();
+      }
+    }
   });
 
 
@@ -1307,7 +1073,7 @@ void web_server_station_setup(void) {
     String type = request->getParam("t", true)->value();
     String id = request->getParam("id", true)->value();
 
-    if (id != "" && (type == "im" || type == "cm" || type == "an" || type == "pl")) {
+    if (id != "" && (type == "im" || type == "cm" || type == "an" || type == "pl" || type == "sc")) {
       ui_request.type = type;
       ui_request.id = id;
       message = ui_request.id + " queued.";
@@ -1320,6 +1086,21 @@ void web_server_station_setup(void) {
     request->send(rc, "application/json", "{\"message\": \""+message+"\"}");
   });
 
+  web_server.on("/image_cache.json", HTTP_GET, [](AsyncWebServerRequest *request) {
+    ImageCacheStats stats = image_cache_stats();
+    String json = "{\"hits\":" + String(stats.hits) + ",\"misses\":" + String(stats.misses) + ",\"evictions\":" + String(stats.evictions) +
+                  ",\"entries\":" + String(stats.entries) + ",\"bytes\":" + String(stats.bytes) + ",\"budget\":" + String(stats.budget) + "}";
+    request->send(200, "application/json", json);
+  });
+
+  // how long images take to get onto the display, see image_stats.h. add ?reset to start counting over.
+  web_server.on("/image_stats.json", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send(200, "application/json", image_stats_json());
+    if (request->hasParam("reset")) {
+      image_stats_reset();
+    }
+  });
+
   web_server.on("/options.json", HTTP_GET, [](AsyncWebServerRequest *request) {
     String options_json = "{\"patterns\":["+patterns_json + "],\"accents\":["+accents_json + "]}"; 
     request->send(200, "application/json", options_json);
@@ -1580,128 +1361,6 @@ void web_server_initiate(void) {
 // end WiFi scanning code taken from ESPAsyncW3ebServer examples
 
 
-void show(void) {
-  static uint32_t pm = 0;
-
-  bool images_waiting = false;
-  for (uint8_t i = 0; i < NUM_LAYERS; i++) {
-    if (layers[i] != nullptr) {
-      // draw layer. changes in layers are not displayed until they are copied to leds[] in the blend block
-      layers[i]->reanimate();
-
-      if (layers[i]->get_type() == Image_t) {
-        // to prevent flickering do not show layers until all images are loaded.
-        int8_t image_status = layers[i]->get_image_status();
-        if (image_status == 0) {
-          images_waiting = true;
-        }
-      }
-    }
-  }
-
-  // blend block
-  uint32_t dt = millis()-pm;
-  if ((dt > show_refresh_interval) && !images_waiting) {
-    pm = millis();
-    //if (dt > REFRESH_INTERVAL) {
-    //  DEBUG_PRINT("dt: ");
-    //  DEBUG_PRINTLN(dt);
-    //}
-    gdynamic_hue+=3;
-    gdynamic_rgb = CHSV(gdynamic_hue, 255, 255);
-    gdynamic_comp_rgb = CRGB::White - gdynamic_rgb;
-    grandom_hue = random8();
-
-    bool first_layer = true;
-    CRGBA pixel;
-    while (true) {
-      if (layers[sli] != nullptr) {
-        if (layers[sli]->get_type() == Image_t) {
-          // it is possible the image may never load, so after so many attempts the image was
-          // marked as broken (-1) by get_image_status()
-          int8_t image_status = layers[sli]->get_image_status();
-          if (image_status == -1) {
-            continue; // skip showing the image, but show the rest of the layers.
-          }
-        }
-        if (first_layer) {
-          first_layer = false;
-          // data in leds[] is written to a black background for first layer
-          // tried white and black bitmasks but clear() is around 10-50 microseconds faster
-          FastLED.clear();
-        }
-        for (uint16_t pi = 0; pi < NUM_LEDS; pi++) {
-          pixel = layers[sli]->get_pixel(pi);
-          CRGB bgpixel = leds[pi];
-          if (layers[sli]->is_xray_pattern()) {
-            // most effects have active pixels that are colored and are opaque or semitransparent.
-            // the active pixels are surrounded by negative space which is fully transparent black.
-            // this allows layers to be drawn on top of each other to combine effects.
-            // for xray patterns we want an opaque negative space which hides what is underneath and
-            // active pixels that reveal what is underneath.
-            // xray patterns are created the same as regular patterns (i.e. transparent negative space)
-            // and then converted to have an opaque negative space and active pixels that are effectively
-            // transparent in this block.
-
-            uint8_t gray_value = (bgpixel.r + bgpixel.g + bgpixel.b) / 3;
-
-            bool is_colored = ((CRGB)pixel != (CRGB)0);
-            if (is_colored) {
-              // use the gray scale value of the pixel below to adjust the pattern's color such that the effect
-              // from the layer below is shown in a new color for the composite
-              nscale8x3(pixel.r, pixel.g, pixel.b, gray_value);
-              // data for bgpixel has been transferred to pixel, so set it to black so nblend() produces the correct output
-              bgpixel = CRGB::Black;
-            }
-            else {
-              // else pixel is fully transparent black or semitransparent black.
-              // if it is fully transparent, then it is negative space, so hide everything beneath by setting alpha to 255 (fully opaque).
-              // if it is opaque black or semi transparent black, then it is an active pixel, so invert its transparency so the pixels
-              // underneath can be seen as is.
-
-              // flipping the opaqueness has the effect of only showing the layer underneath
-              // when the pixels of the layer above are not completely transparent.
-              // that is completely transparent areas become completely opaque and hide what is underneath.
-              pixel.a = 255 - pixel.a;
-            }
-          }
-          // effectively merge pixel that is combination of previous layers with pixel from current layer. flatten.
-          leds[pi] = nblend(bgpixel, (CRGB)pixel, pixel.a);
-        }
-        show_refresh_interval = layers[sli]->display_duration;
-      }
-      else if (art_type == "an") {
-        // empty (nullptr) layers need to have a duration of 0 in order to not stall the gif-like animation
-        show_refresh_interval = 0;
-      }
-
-      sli = (sli + 1) % NUM_LAYERS;
-      if (sli == 0 && art_type == "an") {
-        pl_item_loop_countdown--;
-        break;
-      }
-      if (sli == 0 || art_type == "an") {
-        break;
-      }
-    }
-
-#if HOMOGENIZE_BRIGHTNESS
-    homogenize_brightness();
-#endif
-    // safety measure while testing
-    //if (homogenized_brightness > 128) {
-    //  DEBUG_PRINT("homogenized_brightness > 128: ");
-    //  DEBUG_PRINTLN(homogenized_brightness);
-    //  homogenized_brightness = 128;
-    //}
-
-    FastLED.setBrightness(homogenized_brightness);
-  }
-
-  FastLED.show();
-}
-
-
 void setup() {
   DEBUG_BEGIN(115200);
 
@@ -1712,10 +1371,9 @@ void setup() {
   NUM_LEDS = NUM_ROWS*NUM_COLS;
   LED_STRIP_MILLIAMPS = preferences.getUInt("max_current", DEFAULT_MAX_CURRENT);
   leds = (CRGB*)malloc(NUM_ROWS*NUM_COLS*sizeof(CRGB));
-
-  for (uint8_t i = 0; i < NUM_LAYERS; i++) {
-    layers[i] = nullptr;
-  }
+  tx_leds = (CRGB*)malloc(NUM_ROWS*NUM_COLS*sizeof(CRGB));
+  memset((void*)leds, 0, NUM_ROWS*NUM_COLS*sizeof(CRGB));
+  display_begin(leds, NUM_ROWS, NUM_COLS, ORIENTATION, {image_exists, send_frame});
 
   //The POSIX format is TZ = local_timezone,date/time,date/time.
   //Here, date is in the Mm.n.d format, where:
@@ -1758,7 +1416,7 @@ void setup() {
   // homogenize_brightness_custom() was created to avoid.
   FastLED.setMaxPowerInVoltsAndMilliamps(LED_STRIP_VOLTAGE, LED_STRIP_MILLIAMPS);
   FastLED.setCorrection(TypicalSMD5050);
-  FastLED.addLeds<WS2812B, DATA_PIN, COLOR_ORDER>(leds, NUM_LEDS);
+  FastLED.addLeds<WS2812B, DATA_PIN, COLOR_ORDER>(tx_leds, NUM_LEDS);
   FastLED.setDither(0); // disable temporal dithering. otherwise get flickering for dim pixels.
 
   FastLED.clear();
@@ -1767,6 +1425,12 @@ void setup() {
   homogenize_brightness();
   FastLED.setBrightness(homogenized_brightness);
 
+  // from here on only the output task calls FastLED.show()
+  led_output_start(tx_leds, NUM_LEDS);
+
+  image_cache_init();
+  image_stats_init();
+
   random16_set_seed(analogRead(A0));
 
   if (!LittleFS.begin()) {
@@ -1836,19 +1500,26 @@ void setup() {
     create_file_list();
   }
 
+  // animations put on the filesystem without going through /save, e.g. in a filesystem image, have no binary sequence yet.
+  // only the first boot after that is slower.
+  build_missing_sequences(NUM_LEDS);
+
   while(!create_patterns_list());
   while(!create_accents_list());
 
-  // initialzie dynamic colors because otherwise they won't be set until after layer.refresh() has been called which can lead to partially black text
-  gdynamic_rgb = CHSV(gdynamic_hue, 255, 255);
-  gdynamic_comp_rgb = CRGB::White - gdynamic_rgb;
-
   TaskHandle_t Task1;
 
+  // setup() and loop() run on the same task
+  gloop_task = xTaskGetCurrentTaskHandle();
+  ReAnimator::notify_on_image_load(gloop_task);
+
   // use core 0 to load images to prevent lag
   xTaskCreatePinnedToCore(ReAnimator::load_image_from_queue, "Task1", 10000, NULL, 1, &Task1, 0);
   
   load_file(F("pl"), "startup");
+  // the schedule takes over from the startup playlist once the time is known, if there is one
+  gschedule.id = F("schedule");
+  gschedule.stale = true;
 
 #if DEBUG_LOG == 1
   write_log("setup finished");
@@ -1873,6 +1544,7 @@ void setup() {
 
 
 void loop() {
+  gwake_time = millis() + MAX_LOOP_SLEEP;
 
 #if defined(DEBUG_CONSOLE) || DEBUG_LOG == 1
   char heap_free[18];
@@ -1886,6 +1558,16 @@ void loop() {
 //    DEBUG_PRINTLN(heap_free);
 //#endif
 
+#if defined(DEBUG_CONSOLE)
+    // print the image timings whenever more images have been shown
+    static uint32_t images_reported = 0;
+    uint32_t images_shown = image_stats_get(IMAGE_STAGE_TOTAL).count + image_stats_get(IMAGE_STAGE_CACHED).count;
+    if (images_shown != images_reported) {
+      images_reported = images_shown;
+      DEBUG_PRINT(image_stats_summary());
+    }
+#endif
+
 #if DEBUG_LOG == 1
     if (hp_cnt == 0) {
       write_log(heap_free);
@@ -1914,9 +1596,20 @@ void loop() {
   }
 
   handle_delete_list();
+  handle_save_list();
+  handle_image_uploads();
   handle_ui_request();
+  handle_schedule(time(nullptr));
+  handle_prefetch();
 
   if (tz.unverified_iana_tz != "") {
     verify_timezone(tz.unverified_iana_tz);
   }
+
+  // sleep until something is due instead of spinning, or until the image loader task finishes an image.
+  // a notification given while this pass was running is still pending, so the take returns right away.
+  int32_t sleep_ms = (int32_t)(gwake_time - millis());
+  if (sleep_ms > 0) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep_ms));
+  }
 }
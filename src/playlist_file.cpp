@@ -0,0 +1,124 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#include <LittleFS.h>
+#include <StreamUtils.h>
+#include "ArduinoJson-v6.h"
+#include "playlist_file.h"
+#include "compositor.h"
+#include "project.h"
+
+static const char* const playlist_type_names[] = {"im", "cm", "an"};
+// in the order of Transition
+static const char* const transition_names[] = {"", "crossfade", "wipe", "dissolve"};
+
+
+void Playlist::clear() {
+  // swap instead of clear() so the memory of a long playlist is given back
+  std::vector<PlaylistItem>().swap(items);
+  ids.clear();
+}
+
+
+const char* playlist_type_name(uint8_t type) {
+  return (type < sizeof(playlist_type_names)/sizeof(playlist_type_names[0])) ? playlist_type_names[type] : "";
+}
+
+
+bool compile_playlist(const String& path, Playlist& playlist) {
+  const uint32_t min_interval = 200; // milliseconds
+  const uint16_t min_loops = 1;
+
+  playlist.clear();
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+
+  bool retval = true;
+  ReadBufferingStream bufferedFile(file, 64);
+  // only one item is held in JSON at a time. the "pl" found first may be the value of "t", which is fine
+  // because the item array is the first array in the file either way.
+  if (bufferedFile.find("\"pl\"") && bufferedFile.find("[")) {
+    StaticJsonDocument<256> item;
+    do {
+      DeserializationError error = deserializeJson(item, bufferedFile);
+      if (error) {
+        // an empty array ends up here too, which is fine since it has no items anyway
+        DEBUG_PRINT("deserializeJson() failed: ");
+        DEBUG_PRINTLN(error.c_str());
+        retval = false;
+        break;
+      }
+
+      const char* type = item[F("t")];
+      const char* id = item[F("id")];
+      uint8_t t = 0;
+      while (t < sizeof(playlist_type_names)/sizeof(playlist_type_names[0]) && (type == nullptr || strcmp(type, playlist_type_names[t]) != 0)) {
+        t++;
+      }
+      uint16_t id_offset;
+      if (id == nullptr || t == sizeof(playlist_type_names)/sizeof(playlist_type_names[0]) || !playlist.ids.add(id, id_offset)) {
+        continue;
+      }
+
+      // there are two different ways to control how long a playlist item is shown: by time or by loops for animations.
+      // an item without a duration is shown for a safe amount of time.
+      PlaylistItem pi = {1000, 0, id_offset, TRANSITION_DURATION, t, NO_TRANSITION};
+      if (item[F("d")].is<JsonInteger>()) {
+        if (t == PLAYLIST_AN) {
+          pi.loops = max(item[F("d")].as<uint16_t>(), min_loops);
+          pi.duration = 0;
+        }
+        else {
+          // it takes a bit under 100 ms to load an image
+          // item_intervals of around 100 ms and less can cause the display to appear stalled or act erratic and causes a crash
+          // therefore the minimum item_interval is limited to 200 ms
+          // as a side note animations can have shorter delays than 200 ms because all of the images are loaded into layers at
+          // the same time and the layers are shown one at time, so individual images are not loaded from disk each time a new
+          // frame of the animation is shown
+          pi.duration = max(item[F("d")].as<uint32_t>(), min_interval);
+        }
+      }
+
+      const char* transition = item[F("tr")];
+      for (uint8_t tr = 1; transition != nullptr && tr < sizeof(transition_names)/sizeof(transition_names[0]); tr++) {
+        if (strcmp(transition, transition_names[tr]) == 0) {
+          pi.transition = tr;
+        }
+      }
+      if (item[F("td")].is<JsonInteger>()) {
+        pi.transition_duration = min(item[F("td")].as<uint32_t>(), (uint32_t)UINT16_MAX);
+      }
+      playlist.items.push_back(pi);
+    } while (bufferedFile.findUntil(",", "]"));
+  }
+  file.close();
+
+  if (!retval || playlist.items.empty()) {
+    playlist.clear();
+    return false;
+  }
+  playlist.items.shrink_to_fit();
+  playlist.ids.shrink_to_fit();
+  return true;
+}
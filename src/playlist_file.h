@@ -0,0 +1,58 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+#include "id_table.h"
+
+// playlists ({"t":"pl","pl":[{"t":"im","id":"mona","d":5000}, ...]}) are compiled when they are loaded into a list of
+// fixed size items, so moving to the next item does not walk a JSON document, and a playlist can be as long as memory allows.
+// an item can also say how it replaces the item before it, e.g. {"t":"im","id":"gift","d":3000,"tr":"wipe","td":500},
+// where tr is crossfade, wipe, or dissolve and td is how long that takes in ms (TRANSITION_DURATION if not given).
+
+enum PlaylistItemType : uint8_t {PLAYLIST_IM, PLAYLIST_CM, PLAYLIST_AN};
+
+struct PlaylistItem {
+  uint32_t duration; // ms the item is shown, or 0 if it is shown for a number of loops
+  uint16_t loops;    // times an animation is played, or 0 if it is shown for duration ms
+  uint16_t id;       // where the item's id starts in Playlist::ids
+  uint16_t transition_duration; // ms
+  uint8_t type;      // PlaylistItemType
+  uint8_t transition; // Transition from compositor.h
+};
+
+struct Playlist {
+  std::vector<PlaylistItem> items;
+  IdTable ids;
+
+  const char* id(const PlaylistItem& item) const { return ids.get(item.id); }
+  void clear();
+};
+
+// "im", "cm", or "an"
+const char* playlist_type_name(uint8_t type);
+
+// reads the playlist at path (from form_path()) one item at a time into playlist. items of an unknown type are dropped.
+// fails if the file cannot be parsed or has no items.
+bool compile_playlist(const String& path, Playlist& playlist);
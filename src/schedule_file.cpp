@@ -0,0 +1,159 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#include <LittleFS.h>
+#include <StreamUtils.h>
+#include <algorithm>
+#include "ArduinoJson-v6.h"
+#include "schedule_file.h"
+#include "project.h"
+
+#define MINUTES_PER_DAY 1440
+#define MINUTES_PER_WEEK (7*MINUTES_PER_DAY)
+
+
+void Schedule::clear() {
+  std::vector<ScheduleRule>().swap(rules);
+  ids.clear();
+}
+
+
+// "HH:MM" to minutes since midnight, or -1 if it is not a time of day
+static int16_t parse_time_of_day(const char* at) {
+  unsigned int h, m;
+  char extra;
+  if (at == nullptr || sscanf(at, "%u:%u%c", &h, &m, &extra) != 2 || h > 23 || m > 59) {
+    return -1;
+  }
+  return h*60 + m;
+}
+
+
+bool compile_schedule(const String& path, Schedule& schedule) {
+  schedule.clear();
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+
+  bool retval = true;
+  ReadBufferingStream bufferedFile(file, 64);
+  // like compile_playlist(), only one rule is held in JSON at a time
+  if (bufferedFile.find("\"sc\"") && bufferedFile.find("[")) {
+    StaticJsonDocument<384> rule; // enough for a rule with all seven days
+    do {
+      DeserializationError error = deserializeJson(rule, bufferedFile);
+      if (error) {
+        DEBUG_PRINT("deserializeJson() failed: ");
+        DEBUG_PRINTLN(error.c_str());
+        retval = false;
+        break;
+      }
+
+      int16_t at = parse_time_of_day(rule[F("at")]);
+      const char* id = rule[F("pl")];
+      uint16_t pl;
+      if (at < 0 || id == nullptr || !schedule.ids.add(id, pl)) {
+        continue;
+      }
+
+      uint8_t days = 0x7F;
+      JsonArray dw = rule[F("dw")];
+      if (!dw.isNull()) {
+        days = 0;
+        for (JsonVariant d : dw) {
+          if (d.is<uint8_t>() && d.as<uint8_t>() < 7) {
+            days |= 1 << d.as<uint8_t>();
+          }
+        }
+      }
+
+      for (uint8_t d = 0; d < 7; d++) {
+        if (days & (1 << d)) {
+          schedule.rules.push_back({(uint16_t)(d*MINUTES_PER_DAY + at), pl});
+        }
+      }
+    } while (bufferedFile.findUntil(",", "]"));
+  }
+  file.close();
+
+  if (!retval || schedule.rules.empty()) {
+    schedule.clear();
+    return false;
+  }
+  // when two rules fire at the same minute the one later in the file wins, as if both fired in file order
+  std::stable_sort(schedule.rules.begin(), schedule.rules.end(), [](const ScheduleRule& a, const ScheduleRule& b) { return a.minute < b.minute; });
+  // a rule that loads the playlist already on would only restart it, so it is left out. that includes a rule at the
+  // start of the week after the same playlist at the end of the last one.
+  auto same_playlist = [](const ScheduleRule& a, const ScheduleRule& b) { return a.id == b.id; };
+  schedule.rules.erase(std::unique(schedule.rules.begin(), schedule.rules.end(), same_playlist), schedule.rules.end());
+  if (schedule.rules.size() > 1 && schedule.rules.front().id == schedule.rules.back().id) {
+    schedule.rules.erase(schedule.rules.begin());
+  }
+  schedule.rules.shrink_to_fit();
+  schedule.ids.shrink_to_fit();
+  return true;
+}
+
+
+static uint16_t minute_of_week(const struct tm& local) {
+  return local.tm_wday*MINUTES_PER_DAY + local.tm_hour*60 + local.tm_min;
+}
+
+
+// the first rule that fires after minute, wrapping around to the start of the week
+static size_t next_rule(const Schedule& schedule, uint16_t minute) {
+  auto it = std::upper_bound(schedule.rules.begin(), schedule.rules.end(), minute,
+                             [](uint16_t m, const ScheduleRule& r) { return m < r.minute; });
+  return (it == schedule.rules.end()) ? 0 : it - schedule.rules.begin();
+}
+
+
+const ScheduleRule& schedule_active(const Schedule& schedule, time_t now) {
+  struct tm local;
+  localtime_r(&now, &local);
+  size_t i = next_rule(schedule, minute_of_week(local));
+  return schedule.rules[(i == 0) ? schedule.rules.size()-1 : i-1];
+}
+
+
+time_t schedule_next_fire(const Schedule& schedule, time_t now) {
+  struct tm local;
+  localtime_r(&now, &local);
+  uint16_t minute = minute_of_week(local);
+  const ScheduleRule& rule = schedule.rules[next_rule(schedule, minute)];
+
+  uint16_t ahead = (rule.minute + MINUTES_PER_WEEK - minute) % MINUTES_PER_WEEK;
+  if (ahead == 0) {
+    // the only rule there is, or every rule, is at this minute, so the next time it fires is a week from now
+    ahead = MINUTES_PER_WEEK;
+  }
+  struct tm fire = local;
+  fire.tm_mday += (local.tm_wday*MINUTES_PER_DAY + local.tm_hour*60 + local.tm_min + ahead)/MINUTES_PER_DAY - local.tm_wday;
+  fire.tm_hour = (rule.minute % MINUTES_PER_DAY)/60;
+  fire.tm_min = rule.minute % 60;
+  fire.tm_sec = 0;
+  fire.tm_isdst = -1;
+  time_t t = mktime(&fire);
+  // a local time repeated when daylight saving ends can come out at or before now. try again a minute later.
+  return (t > now) ? t : now + 60;
+}
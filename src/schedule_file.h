@@ -0,0 +1,60 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+#include <vector>
+#include "id_table.h"
+
+// a schedule switches playlists by time of day and day of week without anything polling /load, e.g.
+// {"t":"sc","sc":[{"at":"08:30","dw":[1,2,3,4,5],"pl":"open"},{"at":"22:00","pl":"night"}]}
+// at is local time (see the TZ setup in setup()), dw is the days it applies to with 0 for Sunday as in struct tm
+// (every day if not given), and pl is the playlist to load. the rule that fired last keeps its playlist on until the next one fires.
+//
+// schedules are compiled when they are loaded into a table of rules sorted by minute of the week, so all that has to be
+// done between rules is compare the time against the next fire time.
+
+struct ScheduleRule {
+  uint16_t minute; // minutes since Sunday 00:00
+  uint16_t id;     // where the rule's playlist id starts in Schedule::ids
+};
+
+struct Schedule {
+  std::vector<ScheduleRule> rules; // sorted by minute
+  IdTable ids;                     // the playlist ids
+
+  const char* id(const ScheduleRule& rule) const { return ids.get(rule.id); }
+  void clear();
+};
+
+// reads the schedule at path (from form_path()) into schedule. rules with a bad time or no playlist are dropped.
+// fails if the file cannot be parsed or has no rules.
+bool compile_schedule(const String& path, Schedule& schedule);
+
+// the rule in effect at now, i.e. the last one to fire at or before now. a rule late in the week is still in effect
+// at the start of the next week. schedule must have rules.
+const ScheduleRule& schedule_active(const Schedule& schedule, time_t now);
+
+// when the next rule after now fires. worked out in local time with mktime(), so it follows daylight saving changes.
+time_t schedule_next_fire(const Schedule& schedule, time_t now);
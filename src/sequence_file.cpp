@@ -0,0 +1,340 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#include <LittleFS.h>
+#include <StreamUtils.h>
+#include "ArduinoJson-v6.h"
+#include "sequence_file.h"
+#include "image_file.h"
+#include "project.h"
+
+static const uint8_t sequence_bin_magic[4] = {'P', 'X', 'A', 'N'};
+static const uint8_t sequence_bin_version = 1;
+
+#define FRAME_FLAG_PROXY_COLOR 0x01
+#define FRAME_FLAG_PACKED 0x02
+
+
+String sequence_bin_path(const String& json_path) {
+  String bin_path = json_path;
+  if (bin_path.endsWith(".json")) {
+    bin_path.remove(bin_path.length()-5);
+  }
+  bin_path += SEQUENCE_BIN_EXT;
+  return bin_path;
+}
+
+
+static void put_u16(uint8_t* p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+
+static void put_u32(uint8_t* p, uint32_t v) {
+  put_u16(p, v & 0xFFFF);
+  put_u16(p+2, v >> 16);
+}
+
+
+static uint16_t get_u16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+
+static uint32_t get_u32(const uint8_t* p) {
+  return get_u16(p) | ((uint32_t)get_u16(p+2) << 16);
+}
+
+
+// false if the file is not a binary sequence for num_leds LEDs. num_frames is 0 for an animation made of layers.
+static bool read_header(File& file, uint16_t num_leds, uint16_t& num_frames) {
+  num_frames = 0;
+  uint8_t header[SEQUENCE_BIN_HEADER_SIZE];
+  if (file.readBytes((char*)header, sizeof(header)) != sizeof(header)) {
+    return false;
+  }
+  if (memcmp(header, sequence_bin_magic, sizeof(sequence_bin_magic)) != 0 || header[4] != sequence_bin_version) {
+    return false;
+  }
+  uint16_t n = get_u16(header+8);
+  if (get_u16(header+6) != num_leds || file.size() < SEQUENCE_BIN_HEADER_SIZE + (size_t)n*SEQUENCE_FRAME_ENTRY_SIZE) {
+    return false;
+  }
+  num_frames = n;
+  return true;
+}
+
+
+// returns the number of frames, or 0 if the file is not a binary sequence for num_leds LEDs
+static uint16_t read_header(File& file, uint16_t num_leds) {
+  uint16_t num_frames;
+  read_header(file, num_leds, num_frames);
+  return num_frames;
+}
+
+
+uint16_t read_sequence_bin_header(const String& path, uint16_t num_leds) {
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return 0;
+  }
+  uint16_t num_frames = read_header(file, num_leds);
+  file.close();
+  return num_frames;
+}
+
+
+bool sequence_bin_is_current(const String& path, uint16_t num_leds) {
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+  uint16_t num_frames;
+  bool retval = read_header(file, num_leds, num_frames);
+  file.close();
+  return retval;
+}
+
+
+bool read_sequence_frame(const String& path, uint16_t frame, CRGBA* leds, uint16_t num_leds, bool* proxy_color_set, CRGB* proxy_color, uint32_t* duration) {
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+
+  bool retval = false;
+  uint8_t entry[SEQUENCE_FRAME_ENTRY_SIZE];
+  size_t pixel_bytes = num_leds*sizeof(CRGBA);
+  if (frame < read_header(file, num_leds) && file.seek(SEQUENCE_BIN_HEADER_SIZE + frame*SEQUENCE_FRAME_ENTRY_SIZE) &&
+      file.readBytes((char*)entry, sizeof(entry)) == sizeof(entry)) {
+    uint32_t offset = get_u32(entry);
+    uint16_t size = get_u16(entry+4);
+    uint8_t flags = entry[6];
+    if (offset + size <= file.size() && file.seek(offset)) {
+      if (flags & FRAME_FLAG_PACKED) {
+        uint8_t* packed = (size < pixel_bytes) ? (uint8_t*)malloc(size) : nullptr;
+        if (packed) {
+          retval = (file.readBytes((char*)packed, size) == size) && unpack_image(packed, size, leds, num_leds);
+          free(packed);
+        }
+      }
+      else if (size == pixel_bytes) {
+        retval = (file.readBytes((char*)leds, pixel_bytes) == pixel_bytes);
+      }
+    }
+  }
+  file.close();
+
+  if (retval) {
+    *duration = get_u32(entry+8);
+    *proxy_color_set = entry[6] & FRAME_FLAG_PROXY_COLOR;
+    if (*proxy_color_set) {
+      *proxy_color = CRGB(entry[12], entry[13], entry[14]);
+    }
+  }
+  return retval;
+}
+
+
+// a frame is an image like any other, so it is read the same way the loader task reads images
+static bool read_frame_image(const String& id, CRGBA* leds, uint16_t num_leds, bool* proxy_color_set, CRGB* proxy_color) {
+  String path = form_path(F("im"), id, true);
+  if (read_image_bin(image_bin_path(path), leds, num_leds, proxy_color_set, proxy_color)) {
+    return true;
+  }
+
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+  ReadBufferingStream bufferedFile(file, 64);
+  bool retval = decode_image_json(bufferedFile, leds, num_leds, proxy_color_set, proxy_color);
+  file.close();
+  return retval;
+}
+
+
+// reads only the frame list of a JSON animation into doc. the list is null for an animation made of layers.
+static bool read_frame_list(const String& json_path, DynamicJsonDocument& doc) {
+  File file = LittleFS.open(json_path, "r");
+  if (!file) {
+    return false;
+  }
+
+  // the shortest a frame can be is {"id":"a","d":1}, so that bounds how many frames there can be,
+  // and their ids take no more room than the text they came from.
+  StaticJsonDocument<128> filter;
+  filter[F("f")][0][F("id")] = true;
+  filter[F("f")][0][F("d")] = true;
+  size_t max_frames = file.size()/16 + 1;
+  doc = DynamicJsonDocument(JSON_OBJECT_SIZE(1) + max_frames*(JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(2)) + file.size());
+  ReadBufferingStream bufferedFile(file, 64);
+  DeserializationError error = deserializeJson(doc, bufferedFile, DeserializationOption::Filter(filter));
+  file.close();
+  return !error;
+}
+
+
+// writes just the header, with no frames, to mark an animation made of layers
+static bool write_layers_marker(const String& path, uint16_t num_leds) {
+  uint8_t header[SEQUENCE_BIN_HEADER_SIZE] = {0};
+  memcpy(header, sequence_bin_magic, sizeof(sequence_bin_magic));
+  header[4] = sequence_bin_version;
+  put_u16(header+6, num_leds);
+  File out = LittleFS.open(path, "w");
+  bool retval = out && (out.write(header, sizeof(header)) == sizeof(header));
+  if (out) {
+    out.close();
+  }
+  return retval;
+}
+
+
+bool build_sequence_bin(const String& json_path, const String& bin_path, uint16_t num_leds) {
+  DynamicJsonDocument doc(0);
+  if (!read_frame_list(json_path, doc)) {
+    LittleFS.remove(bin_path);
+    return false;
+  }
+  JsonArray frames = doc[F("f")];
+  // the file is built beside the old one and renamed over it, so a sequence that is playing never reads half of a file
+  String tmp_path = bin_path + ".tmp";
+  if (frames.isNull()) {
+    if (write_layers_marker(tmp_path, num_leds) && LittleFS.rename(tmp_path, bin_path)) {
+      return true;
+    }
+    LittleFS.remove(tmp_path);
+    LittleFS.remove(bin_path);
+    return false;
+  }
+  if (frames.size() == 0 || frames.size() > UINT16_MAX) {
+    LittleFS.remove(bin_path);
+    return false;
+  }
+
+  size_t pixel_bytes = num_leds*sizeof(CRGBA);
+  uint16_t table_size = frames.size();
+  size_t table_bytes = SEQUENCE_BIN_HEADER_SIZE + table_size*SEQUENCE_FRAME_ENTRY_SIZE;
+  uint8_t* table = (uint8_t*)calloc(table_bytes, 1);
+  CRGBA* leds = (CRGBA*)malloc(pixel_bytes);
+  uint8_t* packed = (uint8_t*)malloc(pixel_bytes);
+  File out = (table && leds && packed) ? LittleFS.open(tmp_path, "w") : File();
+
+  // the table is written once as a placeholder to make room for it, then again with the real entries once every frame is in
+  bool retval = out && (out.write(table, table_bytes) == table_bytes);
+  uint32_t offset = table_bytes;
+  uint16_t num_frames = 0;
+  for (uint16_t i = 0; retval && i < table_size; i++) {
+    bool proxy_color_set = false;
+    CRGB proxy_color = CRGB::Black;
+    if (!read_frame_image(frames[i][F("id")] | "", leds, num_leds, &proxy_color_set, &proxy_color)) {
+      continue;
+    }
+
+    size_t size = pack_image(leds, num_leds, packed, pixel_bytes - 1);
+    uint8_t flags = size ? FRAME_FLAG_PACKED : 0;
+    if (!size) {
+      size = pixel_bytes;
+    }
+    if (out.write(size == pixel_bytes ? (const uint8_t*)leds : packed, size) != size) {
+      retval = false;
+      break;
+    }
+
+    uint8_t* entry = table + SEQUENCE_BIN_HEADER_SIZE + num_frames*SEQUENCE_FRAME_ENTRY_SIZE;
+    put_u32(entry, offset);
+    put_u16(entry+4, size);
+    entry[6] = flags | (proxy_color_set ? FRAME_FLAG_PROXY_COLOR : 0);
+    put_u32(entry+8, frames[i][F("d")] | (uint32_t)REFRESH_INTERVAL);
+    if (proxy_color_set) {
+      entry[12] = proxy_color.r;
+      entry[13] = proxy_color.g;
+      entry[14] = proxy_color.b;
+    }
+    offset += size;
+    num_frames++;
+  }
+
+  memcpy(table, sequence_bin_magic, sizeof(sequence_bin_magic));
+  table[4] = sequence_bin_version;
+  put_u16(table+6, num_leds);
+  put_u16(table+8, num_frames);
+  retval = retval && num_frames > 0 && out.seek(0) && (out.write(table, table_bytes) == table_bytes);
+  if (out) {
+    out.close();
+  }
+  retval = retval && LittleFS.rename(tmp_path, bin_path);
+  if (!retval) {
+    LittleFS.remove(tmp_path);
+    LittleFS.remove(bin_path);
+  }
+
+  free(table);
+  free(leds);
+  free(packed);
+  return retval;
+}
+
+
+// calls build for every JSON animation under AN_ROOT with its JSON and binary sequence paths
+template <typename F>
+static void for_each_animation(F build) {
+  File dir = LittleFS.open(AN_ROOT);
+  if (!dir) {
+    return;
+  }
+  while (File entry = dir.openNextFile()) {
+    String filename = entry.name();
+    entry.close();
+    if (filename.endsWith(".json")) {
+      String json_path = String(AN_ROOT "/") + filename;
+      build(json_path, sequence_bin_path(json_path));
+    }
+  }
+  dir.close();
+}
+
+
+void build_missing_sequences(uint16_t num_leds) {
+  for_each_animation([num_leds](const String& json_path, const String& bin_path) {
+    if (!sequence_bin_is_current(bin_path, num_leds)) {
+      build_sequence_bin(json_path, bin_path, num_leds);
+    }
+  });
+}
+
+
+void rebuild_sequences_using(const String& image_id, uint16_t num_leds) {
+  for_each_animation([&image_id, num_leds](const String& json_path, const String& bin_path) {
+    DynamicJsonDocument doc(0);
+    if (!read_frame_list(json_path, doc)) {
+      return;
+    }
+    for (JsonVariant frame : doc[F("f")].as<JsonArray>()) {
+      if (image_id == (frame[F("id")] | "")) {
+        build_sequence_bin(json_path, bin_path, num_leds);
+        return;
+      }
+    }
+  });
+}
@@ -0,0 +1,81 @@
+/*
+  This code is copyright 2024 Jonathan Thomson, jethomson.wordpress.com
+
+  Permission to use, copy, modify, and distribute this software
+  and its documentation for any purpose and without fee is hereby
+  granted, provided that the above copyright notice appear in all
+  copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "FastLED_RGBA.h"
+
+// sprite sheet animations keep every frame in one file and are played by a single layer (see ReAnimator::set_sequence()),
+// so unlike animations made of layers ({"t":"an","l":[...]}) they are not limited to NUM_LAYERS frames.
+// their JSON lists the frames as images with how long each one is shown in ms:
+//   {"t":"an","f":[{"id":"blob0","d":200},{"id":"blob1","d":200},...]}
+// like images, the JSON is what the web pages read and write, and the display plays a binary copy next to it,
+// e.g. /files/an/blob.anim beside /files/an/blob.json, that holds the pixels of every frame.
+//
+// binary sequence layout, all multibyte values little endian:
+//   0  'P' 'X' 'A' 'N'
+//   4  version, currently 1
+//   5  reserved, 0
+//   6  number of pixels in a frame
+//   8  number of frames. 0 marks an animation made of layers, so loading it does not have to parse the JSON to find out.
+//   10 reserved, 0
+//   12 a 16 byte entry for each frame:
+//        0  offset of the frame's pixels from the start of the file
+//        4  size of the frame's pixels
+//        6  flags. bit 0 is set if the frame has a proxy color, bit 1 if its pixels are packed (see pack_image()).
+//        7  reserved, 0
+//        8  how long the frame is shown in ms
+//        12 proxy color as r, g, b
+//        15 reserved, 0
+//   after the entries, the pixels of each frame, packed or as r, g, b, a in leds[] order
+#define SEQUENCE_BIN_EXT ".anim" // same length as .json, see IMAGE_BIN_EXT
+#define SEQUENCE_BIN_HEADER_SIZE 12
+#define SEQUENCE_FRAME_ENTRY_SIZE 16
+
+// the binary sequence path for a JSON animation path from form_path()
+String sequence_bin_path(const String& json_path);
+
+// returns the number of frames in the binary sequence, or 0 if it is missing, is not a binary sequence,
+// or was made for a different number of LEDs
+uint16_t read_sequence_bin_header(const String& path, uint16_t num_leds);
+
+// reads one frame into leds[]. this is what the image loader task calls for each frame a sequence layer needs.
+bool read_sequence_frame(const String& path, uint16_t frame, CRGBA* leds, uint16_t num_leds, bool* proxy_color_set, CRGB* proxy_color, uint32_t* duration);
+
+// true if the binary sequence at path was built for num_leds LEDs, including one that only marks an animation made of layers
+bool sequence_bin_is_current(const String& path, uint16_t num_leds);
+
+// builds the binary sequence from the frame list in a JSON animation. frames whose image is missing or broken are left out.
+// an animation made of layers gets a binary sequence with no frames that marks it as one. returns false, and removes
+// any old binary sequence, if the JSON is not an animation, no frame could be read, or the file could not be written.
+// this reads every frame's image, so it is done when an animation or image is saved and never when one is loaded.
+bool build_sequence_bin(const String& json_path, const String& bin_path, uint16_t num_leds);
+
+// builds the binary sequence of every animation under AN_ROOT that has none or has one for a different number of LEDs,
+// e.g. ones copied onto the filesystem some other way than saving them
+void build_missing_sequences(uint16_t num_leds);
+
+// builds the binary sequence again for each sprite sheet animation that shows the image id, since its frames are copies
+// of the image. sequences that do not show it are left alone.
+void rebuild_sequences_using(const String& image_id, uint16_t num_leds);